@@ -140,7 +140,11 @@ static int read_server(SOCKET sock, char *buffer)
 
 static void write_server(SOCKET sock, const char *buffer)
 {
-   if(send(sock, buffer, strlen(buffer), 0) < 0)
+   /* the server reads newline-terminated commands */
+   char line[BUF_SIZE + 1];
+   int n = snprintf(line, sizeof(line), "%s\n", buffer);
+
+   if(send(sock, line, n, 0) < 0)
    {
       perror("send()");
       exit(errno);
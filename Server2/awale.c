@@ -2,13 +2,121 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define CASES 12
-#define MAX_GRAINS 48
+#include "awale.h"
+#include "zobrist.h"
 
-typedef struct {
-    int cases[CASES];
-    int score[2];
-} Plateau;
+// The 12 pits as one integer, pit i in byte i. Sowing adds to every byte at
+// once; counts stay below 256 so no carry ever crosses into the next pit.
+typedef unsigned __int128 PitVector;
+
+#define PIT_BITS   (8 * CASES)
+#define PITS_MASK  ((((PitVector)1) << PIT_BITS) - 1)
+#define PITS_ONES  ((((PitVector)0x01010101) << 64) | 0x0101010101010101ULL)
+
+_Static_assert(sizeof(Board) == 14, "Board must stay packed");
+
+static PitVector load_pits(const Board *board) {
+    PitVector pits = 0;
+    // Little-endian: pits[i] lands in byte i
+    memcpy(&pits, board->pits, CASES);
+    return pits;
+}
+
+static void store_pits(Board *board, PitVector pits) {
+    memcpy(board->pits, &pits, CASES);
+}
+
+void board_init(Board *board) {
+    memset(board->pits, 4, CASES);
+    board->score[0] = 0;
+    board->score[1] = 0;
+}
+
+// XORs out the old count and in the new one of every pit that changed
+static uint64_t rekey_pits(uint64_t key, PitVector before, PitVector after) {
+    PitVector changed = before ^ after;
+    while (changed) {
+        uint64_t low = (uint64_t)changed;
+        int i = (low ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(changed >> 64))) / 8;
+        key ^= zobrist_pits[i][(uint8_t)(before >> (8 * i))] ^ zobrist_pits[i][(uint8_t)(after >> (8 * i))];
+        changed &= ~(((PitVector)0xFF) << (8 * i));
+    }
+    return key;
+}
+
+// Empties pit and sows its seeds counter-clockwise, skipping the pit itself.
+// Whole laps are one add to all pits but the origin; the remaining seeds (at
+// most 10, so they never reach the origin again) are a run of ones rotated to
+// start just after it. Returns the pit that received the last seed.
+// With a key, the pits that changed are rehashed into it.
+static inline int sow(Board *board, int pit, uint64_t *key) {
+    int seeds = board->pits[pit];
+    if (seeds == 0) {
+        return pit;
+    }
+
+    int laps = seeds / (CASES - 1);
+    int rest = seeds % (CASES - 1);
+    PitVector origin = ((PitVector)1) << (8 * pit);
+    PitVector before = load_pits(board);
+    PitVector pits = before - origin * seeds;
+
+    pits += (PITS_ONES - origin) * laps;
+
+    if (rest > 0) {
+        int shift = 8 * ((pit + 1) % CASES);
+        PitVector run = PITS_ONES & ((((PitVector)1) << (8 * rest)) - 1);
+        pits += ((run << shift) | (run >> (PIT_BITS - shift))) & PITS_MASK;
+    }
+
+    store_pits(board, pits);
+    if (key) {
+        *key = rekey_pits(*key, before, pits);
+    }
+    return rest > 0 ? (pit + rest) % CASES : (pit + CASES - 1) % CASES;
+}
+
+int board_sow(Board *board, int pit) {
+    return sow(board, pit, NULL);
+}
+
+int board_sow_keyed(Board *board, int pit, uint64_t *key) {
+    return sow(board, pit, key);
+}
+
+// Plays pit (0-5) of joueur's camp: sows, then captures backwards from the last
+// seed while it lies in the opponent's camp on a pit holding 2 or 3 seeds.
+// Returns the number of seeds captured.
+int board_play(Board *board, int joueur, int pit) {
+    int last = board_sow(board, pit + (joueur == 1 ? CASES / 2 : 0));
+    int first = joueur == 0 ? CASES / 2 : 0; // Opponent's camp
+    int captured = 0;
+
+    while (last >= first && last < first + CASES / 2 &&
+           (board->pits[last] == 2 || board->pits[last] == 3)) {
+        captured += board->pits[last];
+        board->pits[last] = 0;
+        last--;
+    }
+    board->score[joueur] += captured;
+    return captured;
+}
+
+void board_from_plateau(Board *board, const Plateau *plateau) {
+    for (int i = 0; i < CASES; i++) {
+        board->pits[i] = (uint8_t)plateau->cases[i];
+    }
+    board->score[0] = (uint8_t)plateau->score[0];
+    board->score[1] = (uint8_t)plateau->score[1];
+}
+
+void board_to_plateau(const Board *board, Plateau *plateau) {
+    for (int i = 0; i < CASES; i++) {
+        plateau->cases[i] = board->pits[i];
+    }
+    plateau->score[0] = board->score[0];
+    plateau->score[1] = board->score[1];
+}
 
 void init_plateau(Plateau *plateau) {
     for (int i = 0; i < CASES; i++) {
@@ -34,80 +142,80 @@ int check_famine(Plateau *plateau, int joueur) {
     return 1;
 }
 
-void enregistrer_plateau(FILE *fichier, Plateau *plateau) {
-    fprintf(fichier, "\n  --- Plateau de jeu Awalé ---\n\n");
-    fprintf(fichier, "      +---+---+---+---+---+---+\n      ");
-    for (int i = 11; i >= 6; i--) {
-        fprintf(fichier, " %2d ", plateau->cases[i]);
-    }
-    fprintf(fichier, "\nJ2    +---+---+---+---+---+---+\nJ1    +---+---+---+---+---+---+\n      ");
-    for (int i = 0; i < 6; i++) {
-        fprintf(fichier, " %2d ", plateau->cases[i]);
-    }
-    fprintf(fichier, "\n      +---+---+---+---+---+---+\n");
-    fprintf(fichier, "Score Joueur 1: %d | Score Joueur 2: %d\n", plateau->score[0], plateau->score[1]);
-}
+// Text form of the board. The fixed parts are laid out once in a template;
+// rendering copies it and patches the 12 pits in place (" %2d " fields at
+// known offsets), then appends the two scores.
+#define ENTETE_JEU         "\n  --- Plateau de jeu Awalé ---\n     pour quitter, entrez 0\n"
+#define ENTETE_FICHIER     "\n  --- Plateau de jeu Awalé ---\n\n"
+#define BORDURE            "      +---+---+---+---+---+---+\n"
+#define MARGE              "      "
+#define RANGEE             "                        "
+#define MILIEU             "\nJ2    +---+---+---+---+---+---+\nJ1    +---+---+---+---+---+---+\n"
+#define SCORE_1            "Score Joueur 1: "
+#define SCORE_2            " | Score Joueur 2: "
 
-int jouer_coup(Plateau *plateau, int joueur, int case_choisie) {
-    int index = case_choisie + (joueur == 1 ? 6 : 0);
-    int graines = plateau->cases[index];
-    plateau->cases[index] = 0;
-    int position = index;
-
-    while (graines > 0) {
-        position = (position + 1) % CASES;
-        if (position != index) {
-            plateau->cases[position]++;
-            graines--;
-        }
+static const char modele[] = BORDURE MARGE RANGEE MILIEU MARGE RANGEE "\n" BORDURE SCORE_1;
+
+#define RANGEE_HAUT  (sizeof(BORDURE MARGE) - 1)
+#define RANGEE_BAS   (sizeof(BORDURE MARGE RANGEE MILIEU MARGE) - 1)
+
+_Static_assert(sizeof(ENTETE_JEU) + sizeof(modele) + sizeof(SCORE_2) + 2 * 3 <= PLATEAU_TEXTE_MAX,
+               "PLATEAU_TEXTE_MAX is too small for the board text");
+
+static char *ecrire_nombre(char *out, int valeur) {
+    char chiffres[12];
+    int n = 0;
+    do {
+        chiffres[n++] = (char)('0' + valeur % 10);
+        valeur /= 10;
+    } while (valeur > 0);
+    while (n > 0) {
+        *out++ = chiffres[--n];
     }
+    return out;
+}
 
-    while (est_dans_camp_adverse(joueur, position) && (plateau->cases[position] == 2 || plateau->cases[position] == 3)) {
-        plateau->score[joueur] += plateau->cases[position];
-        plateau->cases[position] = 0;
-        position--;
+static size_t rendre_plateau(char *texte, const char *entete, size_t entete_len, const Plateau *plateau) {
+    memcpy(texte, entete, entete_len);
+    char *grille = texte + entete_len;
+    memcpy(grille, modele, sizeof(modele) - 1);
+    for (int i = 0; i < CASES / 2; i++) {
+        int haut = plateau->cases[CASES - 1 - i];
+        int bas = plateau->cases[i];
+        char *champ = grille + RANGEE_HAUT + 4 * i + 1;
+        champ[0] = haut >= 10 ? (char)('0' + haut / 10) : ' ';
+        champ[1] = (char)('0' + haut % 10);
+        champ = grille + RANGEE_BAS + 4 * i + 1;
+        champ[0] = bas >= 10 ? (char)('0' + bas / 10) : ' ';
+        champ[1] = (char)('0' + bas % 10);
     }
 
-    return plateau->score[joueur] > MAX_GRAINS / 2;
+    char *fin = ecrire_nombre(grille + sizeof(modele) - 1, plateau->score[0]);
+    memcpy(fin, SCORE_2, sizeof(SCORE_2) - 1);
+    fin = ecrire_nombre(fin + sizeof(SCORE_2) - 1, plateau->score[1]);
+    *fin++ = '\n';
+    *fin = '\0';
+    return (size_t)(fin - texte);
 }
 
-const char* afficher_plateau(Plateau *plateau) {
-    // Allocate a buffer large enough to hold the board representation
-    int buffer_size = 512;
-    char *buffer = malloc(buffer_size);
-    if (!buffer) {
-        perror("malloc failed");
-        exit(EXIT_FAILURE);
-    }
+void enregistrer_plateau(FILE *fichier, Plateau *plateau) {
+    char texte[PLATEAU_TEXTE_MAX];
+    size_t len = rendre_plateau(texte, ENTETE_FICHIER, sizeof(ENTETE_FICHIER) - 1, plateau);
+    fwrite(texte, 1, len, fichier);
+}
 
-    snprintf(buffer, buffer_size, "\n  --- Plateau de jeu Awalé ---\n");
-    strncat(buffer, "     pour quitter, entrez 0\n", buffer_size - strlen(buffer) - 1);
-    strncat(buffer, "      +---+---+---+---+---+---+\n      ", buffer_size - strlen(buffer) - 1);
-    
-    // Add top row
-    for (int i = 11; i >= 6; i--) {
-        char temp[16];
-        snprintf(temp, sizeof(temp), " %2d ", plateau->cases[i]);
-        strncat(buffer, temp, buffer_size - strlen(buffer) - 1);
-    }
-    
-    strncat(buffer, "\nJ2    +---+---+---+---+---+---+\nJ1    +---+---+---+---+---+---+\n      ", buffer_size - strlen(buffer) - 1);
-    
-    // Add bottom row
-    for (int i = 0; i < 6; i++) {
-        char temp[16];
-        snprintf(temp, sizeof(temp), " %2d ", plateau->cases[i]);
-        strncat(buffer, temp, buffer_size - strlen(buffer) - 1);
-    }
-    
-    strncat(buffer, "\n      +---+---+---+---+---+---+\n", buffer_size - strlen(buffer) - 1);
+int jouer_coup(Plateau *plateau, int joueur, int case_choisie) {
+    Board board;
+    board_from_plateau(&board, plateau);
+    board_play(&board, joueur, case_choisie);
+    board_to_plateau(&board, plateau);
+    return plateau->score[joueur] > MAX_GRAINS / 2;
+}
 
-    // Add scores
-    char score_str[64];
-    snprintf(score_str, sizeof(score_str), "Score Joueur 1: %d | Score Joueur 2: %d\n", plateau->score[0], plateau->score[1]);
-    strncat(buffer, score_str, buffer_size - strlen(buffer) - 1);
-    
-    return buffer;  // Return the dynamically allocated buffer
+// Writes the board as shown to players into texte (PLATEAU_TEXTE_MAX bytes)
+// and returns its length, NUL excluded
+size_t ecrire_plateau(char *texte, const Plateau *plateau) {
+    return rendre_plateau(texte, ENTETE_JEU, sizeof(ENTETE_JEU) - 1, plateau);
 }
 
 /*int main() {
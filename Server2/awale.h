@@ -2,15 +2,38 @@
 #define AWALE_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #define CASES 12
 #define MAX_GRAINS 48
+#define PLATEAU_TEXTE_MAX 320 // Room for the text written by ecrire_plateau(), NUL included
 
 typedef struct {
     int cases[CASES];
     int score[2];
 } Plateau;
 
+// Compact board used by everything that plays many moves (bots, analysis,
+// simulation). Pits are indexed like Plateau.cases; no count exceeds MAX_GRAINS,
+// so a byte is enough and the 12 pits can be updated together as one 96-bit
+// integer (see board_sow()).
+typedef struct {
+    uint8_t pits[CASES];
+    uint8_t score[2];
+} Board;
+
+void board_init(Board *board);
+
+int board_sow(Board *board, int pit);
+
+int board_sow_keyed(Board *board, int pit, uint64_t *key);
+
+int board_play(Board *board, int joueur, int pit);
+
+void board_from_plateau(Board *board, const Plateau *plateau);
+
+void board_to_plateau(const Board *board, Plateau *plateau);
+
 void init_plateau(Plateau *plateau);
 
 int est_dans_camp_adverse(int joueur, int position);
@@ -21,6 +44,6 @@ void enregistrer_plateau(FILE *fichier, Plateau *plateau);
 
 int jouer_coup(Plateau *plateau, int joueur, int case_choisie);
 
-const char* afficher_plateau(Plateau *plateau);
+size_t ecrire_plateau(char *texte, const Plateau *plateau);
 
 #endif /* AWALE_H */
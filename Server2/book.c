@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "book.h"
+#include "rules.h"
+#include "zobrist.h"
+
+_Static_assert(sizeof(BookEntry) == 24, "Book entries are stored as they are in memory");
+
+// The mapped file; read-only once book_open() returns, so any thread may probe
+static const BookEntry *entries = NULL;
+static uint64_t entry_count = 0;
+static void *mapping = NULL;
+static size_t mapped_size = 0;
+
+// Maps the book at path. Returns 0, or -1 if it is missing or damaged, in
+// which case every move is searched.
+int book_open(const char *path) {
+    BookHeader header;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            perror("open(opening book)");
+        }
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0 || read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, BOOK_MAGIC, sizeof(header.magic)) != 0 ||
+        (uint64_t)st.st_size != sizeof(header) + header.count * sizeof(BookEntry)) {
+        fprintf(stderr, "%s is not a valid opening book\n", path);
+        close(fd);
+        return -1;
+    }
+    if (header.count == 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap(opening book)");
+        return -1;
+    }
+
+    book_close();
+    mapping = map;
+    mapped_size = st.st_size;
+    entries = (const BookEntry *)((const char *)map + sizeof(header));
+    entry_count = header.count;
+    return 0;
+}
+
+void book_close(void) {
+    if (mapping) {
+        munmap(mapping, mapped_size);
+    }
+    mapping = NULL;
+    entries = NULL;
+    entry_count = 0;
+}
+
+// Copies up to max entries for the position into entries. Returns how many.
+int book_probe(const Board *board, int joueur, BookEntry *found, int max) {
+    if (!entries) {
+        return 0;
+    }
+
+    uint64_t key = zobrist_key(board, joueur);
+    uint64_t low = 0;
+    uint64_t high = entry_count;
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (entries[mid].key < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    int count = 0;
+    while (low < entry_count && entries[low].key == key && count < max) {
+        found[count++] = entries[low++];
+    }
+    return count;
+}
+
+// The book's move for the position, or -1 to search. Among the moves played
+// often enough, the one that scored best (draws count half), with one win and
+// one loss added to each so that a single lucky game does not win outright.
+// A best move that does not score at least BOOK_MIN_SCORE is left to the search.
+int book_pick(const Board *board, int joueur) {
+    BookEntry found[CASES / 2];
+    int count = book_probe(board, joueur, found, CASES / 2);
+    int mask = rules_legal_mask(board, joueur);
+    int best = -1;
+    double best_score = -1.0;
+
+    for (int i = 0; i < count; i++) {
+        // A key collision could suggest anything: only legal moves are kept
+        if (found[i].games < BOOK_MIN_GAMES || found[i].move >= CASES / 2 || !(mask & (1 << found[i].move))) {
+            continue;
+        }
+        double score = (found[i].wins + found[i].draws / 2.0 + 1.0) / (found[i].games + 2.0);
+        if (score > best_score) {
+            best_score = score;
+            best = found[i].move;
+        }
+    }
+    return best_score >= BOOK_MIN_SCORE ? best : -1;
+}
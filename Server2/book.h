@@ -0,0 +1,41 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdint.h>
+
+#include "awale.h"
+
+// Opening book mined from the finished games in Database/Games by
+// Tools/book_build.c: for each position (its Zobrist key, player to move
+// included) and each move played there, how often it was played and how it
+// ended for the player who played it. Entries are sorted by key, then move,
+// so a lookup is a binary search in the mapped file.
+
+#define BOOK_MAGIC     "AWBOOK1"
+#define BOOK_FILE      "Database/book.bin"
+#define BOOK_MIN_GAMES 2 // Moves seen less often than this are left to the search
+#define BOOK_MIN_SCORE 0.55 // Nor are moves whose smoothed score is lower than this
+
+typedef struct {
+    char magic[8];
+    uint64_t count; // Entries following the header
+} BookHeader;
+
+typedef struct {
+    uint64_t key;
+    uint8_t move;   // Pit 0-5 of the mover's camp
+    uint8_t unused[3];
+    uint32_t games;
+    uint32_t wins;  // Games the player who made the move won
+    uint32_t draws;
+} BookEntry;
+
+int book_open(const char *path);
+
+void book_close(void);
+
+int book_probe(const Board *board, int joueur, BookEntry *entries, int max);
+
+int book_pick(const Board *board, int joueur);
+
+#endif /* BOOK_H */
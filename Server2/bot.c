@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bot.h"
+#include "book.h"
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static BotJob *head = NULL; // Oldest job first
+static BotJob *tail = NULL;
+static int queued = 0;      // Jobs waiting in the list
+static int stopping = 0;
+static pthread_t *workers = NULL;
+static int worker_count = 0;
+
+// Each thread keeps its table from one job to the next: bot games replay the
+// same openings, and positions from any game stay valid in any other
+static void *bot_main(void *arg) {
+    TransTable tt;
+    tt_init(&tt, BOT_TT_BYTES);
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!head && !stopping) {
+            pthread_cond_wait(&queue_ready, &queue_lock);
+        }
+        if (stopping) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        BotJob *job = head;
+        head = job->next;
+        if (!head) {
+            tail = NULL;
+        }
+        int waiting = --queued;
+        pthread_mutex_unlock(&queue_lock);
+
+        // Under load the budget is shared with the jobs behind this one, so a
+        // full queue drains in a few budgets rather than one budget per job
+        int budget_ms = job->budget_ms / (1 + waiting);
+        int pit = book_pick(&job->board, job->joueur);
+        if (pit >= 0) {
+            // Known openings cost no search at all
+            memset(&job->result, 0, sizeof(job->result));
+            job->result.pit = pit;
+        } else {
+            engine_search(&job->board, job->joueur, budget_ms > 0 ? budget_ms : 1, ENGINE_MAX_DEPTH, &tt, &job->result);
+        }
+        job->done(job);
+    }
+
+    tt_free(&tt);
+    return NULL;
+}
+
+void bot_start(int threads) {
+    workers = malloc(threads * sizeof(pthread_t));
+    if (!workers) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (worker_count = 0; worker_count < threads; worker_count++) {
+        if (pthread_create(&workers[worker_count], NULL, bot_main, NULL) != 0) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void bot_submit(BotJob *job) {
+    job->next = NULL;
+    pthread_mutex_lock(&queue_lock);
+    if (tail) {
+        tail->next = job;
+    } else {
+        head = job;
+    }
+    tail = job;
+    queued++;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+// Jobs still queued are dropped with the process
+void bot_stop(void) {
+    pthread_mutex_lock(&queue_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    worker_count = 0;
+}
@@ -0,0 +1,31 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "awale.h"
+#include "engine.h"
+
+// Searches for the built-in opponent run on their own threads so that no
+// reactor ever waits for one. A finished job is handed back through done(),
+// called on the bot thread; the job belongs to the callback from then on.
+
+#define BOT_NAME    "Bot"
+#define BOT_THREADS 1  // One core searches for every game on the server
+#define BOT_MOVE_MS 20 // Thinking time per bot move: 50 moves a second per thread
+#define BOT_TT_BYTES (16 << 20) // Transposition table of each bot thread
+
+typedef struct BotJob {
+    struct BotJob *next;
+    Board board;
+    int joueur;
+    int budget_ms;
+    SearchResult result;
+    void (*done)(struct BotJob *job);
+} BotJob;
+
+void bot_start(int threads);
+
+void bot_submit(BotJob *job);
+
+void bot_stop(void);
+
+#endif /* BOT_H */
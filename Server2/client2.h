@@ -1,7 +1,34 @@
 #ifndef CLIENT_H
 #define CLIENT_H
 
+#include <stdint.h>
+
 #include "server2.h"
+#include "netbuf.h"
+
+// Stable reference to a client: slot generation in the high half, slot index in
+// the low half. A handle goes stale as soon as its client leaves the slot.
+typedef uint64_t ClientHandle;
+#define NO_CLIENT 0
+
+#define MAX_PENDING_REQUESTS 15
+
+// What the next line from the client answers
+typedef enum {
+    STATE_LOGIN,             // The player name, or the binary protocol hello line
+    STATE_MENU,              // A lobby or in-game command
+    STATE_SET_BIO,           // The new bio
+    STATE_VIEW_BIO,          // Whose bio to show
+    STATE_SEND_FRIEND_REQUEST, // Who to send a friend request to
+    STATE_ANSWER_FRIEND_REQUEST // "<n> accept" or "<n> decline"
+} ClientState;
+
+typedef struct {
+    char **states;  // Array of game states
+    int count;      // Total number of states
+    int current;    // Current state index
+    int capacity;   // Allocated entries in states
+} ReplaySession;
 
 typedef struct {
     int sock;
@@ -10,7 +37,26 @@ typedef struct {
     int room_id;   // Room ID if in a private room
     int waiting_for_response;  // 1 if waiting for a response to a duel request
     int observing; //1 if observing a game
+    int observer_slot; // Entry in the room's observers while observing
     int elo_rating; //win +30 lose -30
+    ClientState state;
+    char pending_requests[MAX_PENDING_REQUESTS][32]; // Requests listed by the last "8"
+    int num_pending_requests;
+    int duel_reactor;  // Reactor owning the other side of a pending duel request
+    ClientHandle duel_handle; // Its handle there, NO_CLIENT if no duel request is pending
+    char duel_name[32];
+    char *games_listing; // Room listing being gathered from every reactor
+    int listing_parts;   // Reactors that have not answered yet
+    ReplaySession replay;
+    uint32_t generation; // Bumped each time the slot is released
+    int live;            // 1 while the slot holds a client
+    int next_free;       // Next free slot while not live
+    int binary;    // 1 if the client opted into the binary protocol (see proto.h)
+    InRing in;     // Received bytes not yet framed into commands
+    OutQueue out;  // Pending output, flushed after each event loop pass
+    int pending;   // 1 if listed in pending_socks[] for the end of the pass
+    int want_write; // 1 if EPOLLOUT is armed
+    int closing;   // 1 if the client stopped reading and must be dropped
 } Client;
 
 #endif /* guard */
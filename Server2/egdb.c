@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "egdb.h"
+
+// ways[m][k]: distributions of m seeds over k pits, C(m + k - 1, k - 1).
+// Column 13 holds the running sums of column 12 (see egdb_level_offset()).
+static uint64_t ways[EGDB_MAX_SEEDS + 2][CASES + 2];
+static pthread_once_t ways_once = PTHREAD_ONCE_INIT;
+
+// The mapped file; read-only once egdb_open() returns, so any thread may probe
+static const int8_t *values = NULL;
+static size_t mapped_size = 0;
+static void *mapping = NULL;
+static int max_seeds = -1;
+
+static void fill_ways(void) {
+    for (int m = 0; m <= EGDB_MAX_SEEDS + 1; m++) {
+        ways[m][0] = m == 0;
+        for (int k = 1; k <= CASES + 1; k++) {
+            ways[m][k] = ways[m][k - 1] + (m > 0 ? ways[m - 1][k] : 0);
+        }
+    }
+}
+
+uint64_t egdb_level_size(int seeds) {
+    pthread_once(&ways_once, fill_ways);
+    return ways[seeds][CASES];
+}
+
+// Levels are stored from 0 seeds up: level n starts after all the smaller ones
+uint64_t egdb_level_offset(int seeds) {
+    pthread_once(&ways_once, fill_ways);
+    return seeds > 0 ? ways[seeds - 1][CASES + 1] : 0;
+}
+
+// Rank of a distribution of seeds among all those of the same total, in
+// lexicographic order of the pit counts. Distributions where pit i holds fewer
+// seeds come first; ways[][] sums them up in one step per pit.
+uint64_t egdb_rank(const uint8_t *pits, int seeds) {
+    uint64_t rank = 0;
+    int left = seeds;
+
+    pthread_once(&ways_once, fill_ways);
+    for (int i = 0; i < CASES - 1; i++) {
+        int k = CASES - 1 - i; // Pits after i
+        rank += ways[left][k + 1] - ways[left - pits[i]][k + 1];
+        left -= pits[i];
+    }
+    return rank;
+}
+
+// The pits as seen by joueur: their own camp first
+void egdb_canonical(const Board *board, int joueur, uint8_t *pits) {
+    int half = CASES / 2;
+    memcpy(pits, board->pits + joueur * half, half);
+    memcpy(pits + half, board->pits + (1 - joueur) * half, half);
+}
+
+// Maps the database at path. Returns 0, or -1 if it is missing or damaged,
+// in which case the engine simply searches endgames like any other position.
+int egdb_open(const char *path) {
+    EgdbHeader header;
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno != ENOENT) {
+            perror("open(endgame database)");
+        }
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0 || read(fd, &header, sizeof(header)) != sizeof(header) ||
+        memcmp(header.magic, EGDB_MAGIC, sizeof(header.magic)) != 0 || header.max_seeds > EGDB_MAX_SEEDS ||
+        (uint64_t)st.st_size != sizeof(header) + egdb_level_offset(header.max_seeds + 1)) {
+        fprintf(stderr, "%s is not a valid endgame database\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap(endgame database)");
+        return -1;
+    }
+
+    egdb_close();
+    mapping = map;
+    mapped_size = st.st_size;
+    values = (const int8_t *)map + sizeof(header);
+    max_seeds = (int)header.max_seeds;
+    return 0;
+}
+
+void egdb_close(void) {
+    if (mapping) {
+        munmap(mapping, mapped_size);
+    }
+    mapping = NULL;
+    values = NULL;
+    max_seeds = -1;
+}
+
+// Seeds on the board up to which egdb_probe() answers, -1 without a database
+int egdb_max_seeds(void) {
+    return max_seeds;
+}
+
+// Returns 1 and the value for joueur to move if the position is in the database
+int egdb_probe(const Board *board, int joueur, int *value) {
+    int seeds = 0;
+    for (int i = 0; i < CASES; i++) {
+        seeds += board->pits[i];
+    }
+    if (seeds > max_seeds) {
+        return 0;
+    }
+
+    uint8_t pits[CASES];
+    egdb_canonical(board, joueur, pits);
+    *value = values[egdb_level_offset(seeds) + egdb_rank(pits, seeds)];
+    return 1;
+}
@@ -0,0 +1,49 @@
+#ifndef EGDB_H
+#define EGDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "awale.h"
+
+// Endgame database: the outcome of perfect play for every position with up
+// to a few seeds left on the board, built offline by Tools/egdb_gen.c and
+// mapped read-only into memory, so one lookup costs one page access at most.
+//
+// A value is the number of the remaining seeds that the player to move will
+// get, minus those the opponent will get, when both play perfectly to the end.
+// The scores so far do not matter, so positions are stored by pits alone, as
+// seen by the player to move (their camp first). Positions are grouped by the
+// number of seeds on the board, then ranked among the distributions of that
+// many seeds over the 12 pits (see egdb_rank()).
+//
+// Play that goes on forever without a capture is scored as if the game ended
+// there: each player keeps the seeds in their own camp.
+
+#define EGDB_MAGIC     "AWEGDB1"
+#define EGDB_MAX_SEEDS 20 // Largest database the index arithmetic allows
+#define EGDB_FILE      "Database/endgame.db"
+
+typedef struct {
+    char magic[8];
+    uint32_t max_seeds; // Levels 0 to max_seeds follow the header, in order
+    uint32_t reserved;
+} EgdbHeader;
+
+uint64_t egdb_level_size(int seeds);
+
+uint64_t egdb_level_offset(int seeds);
+
+uint64_t egdb_rank(const uint8_t *pits, int seeds);
+
+void egdb_canonical(const Board *board, int joueur, uint8_t *pits);
+
+int egdb_open(const char *path);
+
+void egdb_close(void);
+
+int egdb_max_seeds(void);
+
+int egdb_probe(const Board *board, int joueur, int *value);
+
+#endif /* EGDB_H */
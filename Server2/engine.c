@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "engine.h"
+#include "egdb.h"
+#include "rules.h"
+#include "timer.h"
+#include "zobrist.h"
+
+#define CLOCK_CHECK_NODES 1024 // Nodes between two looks at the clock
+
+typedef struct {
+    TransTable *tt;   // NULL to search without one
+    uint64_t deadline;
+    const int *abort; // Raised when a parallel search is over, NULL if alone
+    uint64_t nodes;
+    TTStats stats;    // Added to the table's once the search is over
+    int stopped;      // 1 once the budget ran out; the iteration in progress is discarded
+} SearchContext;
+
+// A thread of a parallel search, with its own context and result
+typedef struct {
+    SearchContext ctx;
+    const Board *board;
+    int joueur;
+    int max_depth;
+    int id;
+    SearchResult result;
+    pthread_t thread;
+} Helper;
+
+// The result of a finished game, from joueur's side; quicker wins score higher
+static int terminal_score(const Board *board, int joueur, int ply) {
+    int winner = rules_winner(board);
+    if (winner == RULES_DRAW) {
+        return 0;
+    }
+    return winner == joueur ? ENGINE_WIN - ply : -(ENGINE_WIN - ply);
+}
+
+// Forced results are stored relative to the position, not to the root
+static int score_to_tt(int score, int ply) {
+    if (score > ENGINE_WIN - ENGINE_MAX_DEPTH) {
+        return score + ply;
+    }
+    return score < -(ENGINE_WIN - ENGINE_MAX_DEPTH) ? score - ply : score;
+}
+
+static int score_from_tt(int score, int ply) {
+    if (score > ENGINE_WIN - ENGINE_MAX_DEPTH) {
+        return score - ply;
+    }
+    return score < -(ENGINE_WIN - ENGINE_MAX_DEPTH) ? score + ply : score;
+}
+
+// Lists the moves of mask with first (if legal) at the front. Returns the count.
+// The others follow from pit skew on, so that threads differ in their order.
+static int order_moves(int mask, int first, int skew, int *order) {
+    int count = 0;
+    if (first >= 0 && (mask & (1 << first))) {
+        order[count++] = first;
+    }
+    for (int k = 0; k < CASES / 2; k++) {
+        int pit = (k + skew) % (CASES / 2);
+        if ((mask & (1 << pit)) && pit != first) {
+            order[count++] = pit;
+        }
+    }
+    return count;
+}
+
+static int negamax(SearchContext *ctx, const Board *board, uint64_t key, int joueur, int depth, int ply, int alpha, int beta) {
+    if ((++ctx->nodes & (CLOCK_CHECK_NODES - 1)) == 0 &&
+        (timer_now() >= ctx->deadline || (ctx->abort && __atomic_load_n(ctx->abort, __ATOMIC_RELAXED)))) {
+        ctx->stopped = 1;
+    }
+    if (ctx->stopped) {
+        return 0;
+    }
+
+    Board position = *board;
+    if (rules_game_over(&position, joueur)) {
+        return terminal_score(&position, joueur, ply);
+    }
+    // Close to the end the database knows how the remaining seeds will split
+    int rest;
+    if (egdb_probe(&position, joueur, &rest)) {
+        return position.score[joueur] - position.score[1 - joueur] + rest;
+    }
+    if (depth == 0) {
+        return position.score[joueur] - position.score[1 - joueur];
+    }
+
+    // A result from another path to this position may settle it; if not, its
+    // best move is tried first
+    int hint = -1;
+    TTEntry entry;
+    if (ctx->tt) {
+        ctx->stats.probes++;
+    }
+    if (ctx->tt && tt_probe(ctx->tt, key, &entry)) {
+        int score = score_from_tt(entry.score, ply);
+        ctx->stats.hits++;
+        hint = entry.move;
+        if (entry.depth >= depth &&
+            (entry.bound == TT_EXACT ||
+             (entry.bound == TT_LOWER && score >= beta) ||
+             (entry.bound == TT_UPPER && score <= alpha))) {
+            return score;
+        }
+    }
+
+    int order[CASES / 2];
+    int count = order_moves(rules_legal_mask(&position, joueur), hint, 0, order);
+    int original_alpha = alpha;
+    int best = -ENGINE_WIN - 1;
+    int best_pit = -1;
+    for (int k = 0; k < count; k++) {
+        Board child = position;
+        uint64_t child_key = key;
+        rules_play_keyed(&child, joueur, order[k], &child_key);
+        int score = -negamax(ctx, &child, child_key, 1 - joueur, depth - 1, ply + 1, -beta, -alpha);
+        if (score > best) {
+            best = score;
+            best_pit = order[k];
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+        if (alpha >= beta) {
+            break;
+        }
+    }
+
+    if (ctx->tt && !ctx->stopped) {
+        int bound = best <= original_alpha ? TT_UPPER : best >= beta ? TT_LOWER : TT_EXACT;
+        ctx->stats.stores++;
+        ctx->stats.overwrites += tt_store(ctx->tt, key, depth, score_to_tt(best, ply), bound, best_pit);
+    }
+    return best;
+}
+
+// Searches the root moves with the best one of the previous iteration first
+static int search_root(SearchContext *ctx, const Board *board, int joueur, int depth, int first, int skew, int *best_pit) {
+    uint64_t key = zobrist_key(board, joueur);
+    int order[CASES / 2];
+    int count = order_moves(rules_legal_mask(board, joueur), first, skew, order);
+    int alpha = -ENGINE_WIN - 1;
+
+    *best_pit = -1;
+    for (int k = 0; k < count; k++) {
+        Board child = *board;
+        uint64_t child_key = key;
+        rules_play_keyed(&child, joueur, order[k], &child_key);
+        int score = -negamax(ctx, &child, child_key, 1 - joueur, depth - 1, 1, -ENGINE_WIN - 1, -alpha);
+        if (ctx->stopped) {
+            break;
+        }
+        if (score > alpha) {
+            alpha = score;
+            *best_pit = order[k];
+        }
+    }
+    return alpha;
+}
+
+// Iterative deepening from first_depth to max_depth, or until the search stops.
+// result->pit is a legal move whenever there is one, even if not a single
+// iteration completed.
+static void deepen(SearchContext *ctx, const Board *board, int joueur, int first_depth, int max_depth, int skew,
+                   SearchResult *result) {
+    int mask = rules_legal_mask(board, joueur);
+    int rest;
+
+    memset(result, 0, sizeof(*result));
+    result->pit = -1;
+    for (int pit = 0; pit < CASES / 2 && result->pit < 0; pit++) {
+        if (mask & (1 << pit)) {
+            result->pit = pit;
+        }
+    }
+    // Every move from a position in the endgame database leads to one, or
+    // ends the game: one ply is exact
+    if (egdb_probe(board, joueur, &rest)) {
+        first_depth = 1;
+        max_depth = 1;
+    }
+
+    for (int depth = first_depth; depth <= max_depth && result->pit >= 0; depth++) {
+        int pit;
+        int score = search_root(ctx, board, joueur, depth, result->depth > 0 ? result->pit : -1, skew, &pit);
+        if (ctx->stopped || pit < 0) {
+            break;
+        }
+        result->pit = pit;
+        result->score = score;
+        result->depth = depth;
+        // A forced result will not change with more depth
+        if (score >= ENGINE_WIN - depth || score <= -(ENGINE_WIN - depth)) {
+            break;
+        }
+    }
+    result->nodes = ctx->nodes;
+}
+
+// Helpers search the same root as the main thread, half of them one ply
+// ahead, each with its own move order. They share nothing but the table,
+// where they leave bounds and moves that cut the main thread's tree short.
+static void *helper_main(void *arg) {
+    Helper *helper = arg;
+    deepen(&helper->ctx, helper->board, helper->joueur, 1 + (helper->id & 1), helper->max_depth,
+           helper->id, &helper->result);
+    return NULL;
+}
+
+// Finds a move for joueur within budget_ms. Always returns a legal move when
+// there is one, even if not a single iteration completed in time. tt, if not
+// NULL, may hold entries from earlier searches: keys cover the whole position.
+void engine_search(const Board *board, int joueur, int budget_ms, int max_depth, TransTable *tt, SearchResult *result) {
+    engine_search_parallel(board, joueur, budget_ms, max_depth, 1, tt, result);
+}
+
+// Lazy SMP: threads search the same position and share tt, which they need
+// to be of any help. The deepest result wins, the main thread's on a tie;
+// nodes add up over all threads.
+void engine_search_parallel(const Board *board, int joueur, int budget_ms, int max_depth, int threads,
+                            TransTable *tt, SearchResult *result) {
+    uint64_t deadline = timer_now() + budget_ms;
+    int abort = 0;
+    Helper *helpers = NULL;
+
+    if (max_depth > ENGINE_MAX_DEPTH) {
+        max_depth = ENGINE_MAX_DEPTH;
+    }
+    if (threads > ENGINE_MAX_THREADS) {
+        threads = ENGINE_MAX_THREADS;
+    }
+    if (threads > 1) {
+        helpers = calloc(threads - 1, sizeof(Helper));
+        if (!helpers) {
+            perror("calloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < threads - 1; i++) {
+        Helper *helper = &helpers[i];
+        helper->ctx.tt = tt;
+        helper->ctx.deadline = deadline;
+        helper->ctx.abort = &abort;
+        helper->board = board;
+        helper->joueur = joueur;
+        helper->max_depth = max_depth;
+        helper->id = i + 1;
+        if (pthread_create(&helper->thread, NULL, helper_main, helper) != 0) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    SearchContext ctx = {tt, deadline, NULL, 0, {0}, 0};
+    deepen(&ctx, board, joueur, 1, max_depth, 0, result);
+    if (tt) {
+        tt_add_stats(tt, &ctx.stats);
+    }
+
+    __atomic_store_n(&abort, 1, __ATOMIC_RELAXED);
+    uint64_t nodes = result->nodes;
+    for (int i = 0; i < threads - 1; i++) {
+        pthread_join(helpers[i].thread, NULL);
+        if (helpers[i].result.depth > result->depth) {
+            *result = helpers[i].result;
+        }
+        nodes += helpers[i].result.nodes;
+        if (tt) {
+            tt_add_stats(tt, &helpers[i].ctx.stats);
+        }
+    }
+    result->nodes = nodes;
+    free(helpers);
+}
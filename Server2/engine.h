@@ -0,0 +1,29 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#include "awale.h"
+#include "tt.h"
+
+// Game-tree search for the built-in opponent and the analysis tools: negamax
+// with alpha-beta pruning, deepened one ply at a time until the time budget or
+// the depth limit runs out, on one thread or several (Lazy SMP).
+
+#define ENGINE_MAX_DEPTH   64
+#define ENGINE_MAX_THREADS 256
+#define ENGINE_WIN         10000 // Score of a won position, minus the plies to reach it
+
+typedef struct {
+    int pit;        // Best move (0-5 in the mover's camp), -1 if there is none
+    int score;      // Seed difference for the mover, or about ENGINE_WIN for a forced result
+    int depth;      // Deepest iteration that completed
+    uint64_t nodes; // Positions visited
+} SearchResult;
+
+void engine_search(const Board *board, int joueur, int budget_ms, int max_depth, TransTable *tt, SearchResult *result);
+
+void engine_search_parallel(const Board *board, int joueur, int budget_ms, int max_depth, int threads,
+                            TransTable *tt, SearchResult *result);
+
+#endif /* ENGINE_H */
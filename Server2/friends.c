@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "friends.h"
+
+#define NO_ID -1
+
+typedef struct {
+    int *ids;
+    int count;
+    int capacity;
+} IdList;
+
+// A pending request, linked into the list of its receiver in arrival order
+typedef struct {
+    int sender;
+    int receiver;
+    int prev;  // Request index or NO_ID; next free request while unused
+    int next;
+} FriendRequest;
+
+typedef struct {
+    int head;
+    int tail;
+    int count;
+} RequestList;
+
+static pthread_rwlock_t friends_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Interned names: id -> name, and a hash index name -> id
+static char (*names)[PLAYER_NAME_SIZE] = NULL;
+static IdList *adjacency = NULL; // By id
+static RequestList *incoming = NULL; // By id of the receiver
+static int name_count = 0;
+static int name_capacity = 0;
+static int *name_slots = NULL;   // Open addressing, linear probing: id or NO_ID
+static int name_mask = -1;
+
+// Friendships as ((smaller id + 1) << 32 | (larger id + 1)), 0 marks a free slot
+static uint64_t *edges = NULL;
+static int edge_count = 0;
+static int edge_mask = -1;
+
+static FILE *log_file = NULL;
+
+// Pending requests: a pool with a free list, and a hash index from
+// ((sender + 1) << 32 | (receiver + 1)) to the request, 0 marks a free slot
+static FriendRequest *requests = NULL;
+static int request_capacity = 0;
+static int free_request = NO_ID;
+static uint64_t *request_keys = NULL;
+static int *request_slots = NULL;
+static int request_count = 0;
+static int request_mask = -1;
+static int request_records = 0; // Lines in FRIEND_REQUESTS_FILE
+
+static FILE *request_log = NULL;
+
+static void *checked_realloc(void *p, size_t size) {
+    void *grown = realloc(p, size);
+    if (!grown) {
+        perror("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+// FNV-1a
+static uint64_t hash_name(const char *name) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static int find_name_slot(const char *name) {
+    int slot = (int)(hash_name(name) & (uint64_t)name_mask);
+    while (name_slots[slot] != NO_ID && strcmp(names[name_slots[slot]], name) != 0) {
+        slot = (slot + 1) & name_mask;
+    }
+    return slot;
+}
+
+static int find_id(const char *name) {
+    return name_mask < 0 ? NO_ID : name_slots[find_name_slot(name)];
+}
+
+// The id of name, given one if it has none yet
+static int intern(const char *name) {
+    if (name_mask < 0 || (name_count + 1) * 2 > name_mask + 1) {
+        int slot_count = name_mask < 0 ? 1024 : (name_mask + 1) * 2;
+        free(name_slots);
+        name_slots = malloc(slot_count * sizeof(int));
+        if (!name_slots) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(name_slots, 0xFF, slot_count * sizeof(int)); // NO_ID everywhere
+        name_mask = slot_count - 1;
+        for (int id = 0; id < name_count; id++) {
+            name_slots[find_name_slot(names[id])] = id;
+        }
+    }
+
+    int slot = find_name_slot(name);
+    if (name_slots[slot] != NO_ID) {
+        return name_slots[slot];
+    }
+    if (name_count == name_capacity) {
+        name_capacity = name_capacity ? name_capacity * 2 : 256;
+        names = checked_realloc(names, name_capacity * sizeof(*names));
+        adjacency = checked_realloc(adjacency, name_capacity * sizeof(IdList));
+        incoming = checked_realloc(incoming, name_capacity * sizeof(RequestList));
+    }
+    strncpy(names[name_count], name, PLAYER_NAME_SIZE - 1);
+    names[name_count][PLAYER_NAME_SIZE - 1] = '\0';
+    memset(&adjacency[name_count], 0, sizeof(IdList));
+    incoming[name_count].head = incoming[name_count].tail = NO_ID;
+    incoming[name_count].count = 0;
+    name_slots[slot] = name_count;
+    return name_count++;
+}
+
+static uint64_t edge_key(int id1, int id2) {
+    int low = id1 < id2 ? id1 : id2;
+    int high = id1 < id2 ? id2 : id1;
+    return ((uint64_t)(low + 1) << 32) | (uint64_t)(high + 1);
+}
+
+// The slot holding key, or the free slot where it would go
+static int find_edge_slot(uint64_t key) {
+    int slot = (int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & edge_mask;
+    while (edges[slot] != 0 && edges[slot] != key) {
+        slot = (slot + 1) & edge_mask;
+    }
+    return slot;
+}
+
+static int has_edge(int id1, int id2) {
+    return edge_mask >= 0 && edges[find_edge_slot(edge_key(id1, id2))] != 0;
+}
+
+static void list_push(IdList *list, int id) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 4;
+        list->ids = checked_realloc(list->ids, list->capacity * sizeof(int));
+    }
+    list->ids[list->count++] = id;
+}
+
+// Records a friendship in memory. Returns 1 if it is new.
+static int link_ids(int id1, int id2) {
+    if (edge_mask < 0 || (edge_count + 1) * 2 > edge_mask + 1) {
+        int old_size = edge_mask + 1;
+        uint64_t *old = edges;
+        int size = old_size ? old_size * 2 : 1024;
+        edges = calloc(size, sizeof(uint64_t));
+        if (!edges) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+        edge_mask = size - 1;
+        for (int i = 0; i < old_size; i++) {
+            if (old[i]) {
+                edges[find_edge_slot(old[i])] = old[i];
+            }
+        }
+        free(old);
+    }
+
+    uint64_t key = edge_key(id1, id2);
+    int slot = find_edge_slot(key);
+    if (edges[slot] != 0) {
+        return 0;
+    }
+    edges[slot] = key;
+    edge_count++;
+    list_push(&adjacency[id1], id2);
+    list_push(&adjacency[id2], id1);
+    return 1;
+}
+
+static uint64_t request_key(int sender, int receiver) {
+    return ((uint64_t)(sender + 1) << 32) | (uint64_t)(receiver + 1);
+}
+
+static int home_slot(uint64_t key, int mask) {
+    return (int)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+// The slot holding key, or the free slot where it would go
+static int find_request_slot(uint64_t key) {
+    int slot = home_slot(key, request_mask);
+    while (request_keys[slot] != 0 && request_keys[slot] != key) {
+        slot = (slot + 1) & request_mask;
+    }
+    return slot;
+}
+
+static int find_request(int sender, int receiver) {
+    if (request_mask < 0) {
+        return NO_ID;
+    }
+    int slot = find_request_slot(request_key(sender, receiver));
+    return request_keys[slot] ? request_slots[slot] : NO_ID;
+}
+
+static void grow_request_index(void) {
+    int old_size = request_mask + 1;
+    uint64_t *old_keys = request_keys;
+    int *old_slots = request_slots;
+    int size = old_size ? old_size * 2 : 1024;
+    request_keys = calloc(size, sizeof(uint64_t));
+    request_slots = malloc(size * sizeof(int));
+    if (!request_keys || !request_slots) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    request_mask = size - 1;
+    for (int i = 0; i < old_size; i++) {
+        if (old_keys[i]) {
+            int slot = find_request_slot(old_keys[i]);
+            request_keys[slot] = old_keys[i];
+            request_slots[slot] = old_slots[i];
+        }
+    }
+    free(old_keys);
+    free(old_slots);
+}
+
+// Records a pending request in memory. Returns 1 if it is new.
+static int add_request(int sender, int receiver) {
+    if (request_mask < 0 || (request_count + 1) * 2 > request_mask + 1) {
+        grow_request_index();
+    }
+    uint64_t key = request_key(sender, receiver);
+    int slot = find_request_slot(key);
+    if (request_keys[slot] != 0) {
+        return 0;
+    }
+
+    if (free_request == NO_ID) {
+        int old_capacity = request_capacity;
+        request_capacity = request_capacity ? request_capacity * 2 : 256;
+        requests = checked_realloc(requests, request_capacity * sizeof(FriendRequest));
+        for (int i = request_capacity - 1; i >= old_capacity; i--) {
+            requests[i].next = free_request;
+            free_request = i;
+        }
+    }
+    int index = free_request;
+    free_request = requests[index].next;
+
+    RequestList *list = &incoming[receiver];
+    FriendRequest *request = &requests[index];
+    request->sender = sender;
+    request->receiver = receiver;
+    request->prev = list->tail;
+    request->next = NO_ID;
+    if (list->tail != NO_ID) {
+        requests[list->tail].next = index;
+    } else {
+        list->head = index;
+    }
+    list->tail = index;
+    list->count++;
+
+    request_keys[slot] = key;
+    request_slots[slot] = index;
+    request_count++;
+    return 1;
+}
+
+// Forgets a pending request. Returns 1 if there was one.
+static int drop_request(int sender, int receiver) {
+    if (request_mask < 0) {
+        return 0;
+    }
+    int slot = find_request_slot(request_key(sender, receiver));
+    if (request_keys[slot] == 0) {
+        return 0;
+    }
+    int index = request_slots[slot];
+
+    // Linear probing: pull back the entries that probed past the freed slot
+    request_keys[slot] = 0;
+    for (int next = (slot + 1) & request_mask; request_keys[next] != 0; next = (next + 1) & request_mask) {
+        int home = home_slot(request_keys[next], request_mask);
+        if (((next - home) & request_mask) >= ((next - slot) & request_mask)) {
+            request_keys[slot] = request_keys[next];
+            request_slots[slot] = request_slots[next];
+            request_keys[next] = 0;
+            slot = next;
+        }
+    }
+
+    RequestList *list = &incoming[receiver];
+    FriendRequest *request = &requests[index];
+    if (request->prev != NO_ID) {
+        requests[request->prev].next = request->next;
+    } else {
+        list->head = request->next;
+    }
+    if (request->next != NO_ID) {
+        requests[request->next].prev = request->prev;
+    } else {
+        list->tail = request->prev;
+    }
+    list->count--;
+    request->next = free_request;
+    free_request = index;
+    request_count--;
+    return 1;
+}
+
+// Replays the request log: "sender|receiver" adds a request, and
+// "sender|receiver|-" withdraws it
+static void load_requests(void) {
+    FILE *file = fopen(FRIEND_REQUESTS_FILE, "r");
+    if (!file) {
+        return;
+    }
+    char *line = NULL;
+    size_t size = 0;
+    while (getline(&line, &size, file) != -1) {
+        char *saved = NULL;
+        char *sender = strtok_r(line, "|", &saved);
+        char *receiver = strtok_r(NULL, "|\n", &saved);
+        char *mark = strtok_r(NULL, "\n", &saved);
+        if (!sender || !receiver) {
+            continue;
+        }
+        request_records++;
+        if (mark && strcmp(mark, "-") == 0) {
+            int sender_id = find_id(sender);
+            int receiver_id = find_id(receiver);
+            if (sender_id != NO_ID && receiver_id != NO_ID) {
+                drop_request(sender_id, receiver_id);
+            }
+        } else {
+            add_request(intern(sender), intern(receiver));
+        }
+    }
+    free(line);
+    fclose(file);
+}
+
+// Rewrites the request log with the pending requests only, once withdrawn
+// requests make up most of it. Runs at startup, before the log is reopened.
+static void compact_requests(void) {
+    if (request_records <= 2 * request_count) {
+        return;
+    }
+    FILE *file = fopen(FRIEND_REQUESTS_TEMP_FILE, "w");
+    if (!file) {
+        perror("Failed to open temporary file for friend_requests.txt");
+        return;
+    }
+    // Receiver by receiver, so that each pending list keeps its order
+    for (int id = 0; id < name_count; id++) {
+        for (int i = incoming[id].head; i != NO_ID; i = requests[i].next) {
+            fprintf(file, "%s|%s\n", names[requests[i].sender], names[id]);
+        }
+    }
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        perror("Failed to write the friend requests");
+        fclose(file);
+        return;
+    }
+    fclose(file);
+    if (rename(FRIEND_REQUESTS_TEMP_FILE, FRIEND_REQUESTS_FILE) != 0) {
+        perror("Failed to rename temporary file to friend_requests.txt");
+        return;
+    }
+    request_records = request_count;
+}
+
+// Replays the log. Lines are read whole, however many friends they list.
+int friends_open(void) {
+    pthread_rwlock_wrlock(&friends_lock);
+    FILE *file = fopen(FRIENDS_FILE, "r");
+    if (file) {
+        char *line = NULL;
+        size_t size = 0;
+        while (getline(&line, &size, file) != -1) {
+            char *saved = NULL;
+            char *player = strtok_r(line, "|", &saved);
+            char *friend_list = strtok_r(NULL, "\n", &saved);
+            if (!player || !friend_list) {
+                continue;
+            }
+            int id = intern(player);
+            for (char *name = strtok_r(friend_list, ",", &saved); name; name = strtok_r(NULL, ",", &saved)) {
+                if (strcmp(name, player) != 0) {
+                    link_ids(id, intern(name));
+                }
+            }
+        }
+        free(line);
+        fclose(file);
+    }
+
+    load_requests();
+    compact_requests();
+
+    log_file = fopen(FRIENDS_FILE, "a");
+    request_log = fopen(FRIEND_REQUESTS_FILE, "a");
+    if (!log_file || !request_log) {
+        perror("Failed to open friends.txt or friend_requests.txt");
+        pthread_rwlock_unlock(&friends_lock);
+        return -1;
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return 0;
+}
+
+void friends_close(void) {
+    pthread_rwlock_wrlock(&friends_lock);
+    if (log_file) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+    if (request_log) {
+        fclose(request_log);
+        request_log = NULL;
+    }
+    for (int id = 0; id < name_count; id++) {
+        free(adjacency[id].ids);
+    }
+    free(adjacency);
+    free(incoming);
+    free(requests);
+    free(request_keys);
+    free(request_slots);
+    incoming = NULL;
+    requests = NULL;
+    request_keys = NULL;
+    request_slots = NULL;
+    request_capacity = request_count = request_records = 0;
+    free_request = NO_ID;
+    request_mask = -1;
+    free(names);
+    free(name_slots);
+    free(edges);
+    adjacency = NULL;
+    names = NULL;
+    name_slots = NULL;
+    edges = NULL;
+    name_count = name_capacity = edge_count = 0;
+    name_mask = edge_mask = -1;
+    pthread_rwlock_unlock(&friends_lock);
+}
+
+int friends_are(const char *name1, const char *name2) {
+    pthread_rwlock_rdlock(&friends_lock);
+    int id1 = find_id(name1);
+    int id2 = find_id(name2);
+    int are = id1 != NO_ID && id2 != NO_ID && has_edge(id1, id2);
+    pthread_rwlock_unlock(&friends_lock);
+    return are;
+}
+
+// Makes the two players friends, appending one line to the log if they were
+// not already. Returns 1 if the friendship is new.
+int friends_add(const char *name1, const char *name2) {
+    if (strcmp(name1, name2) == 0) {
+        return 0;
+    }
+    pthread_rwlock_wrlock(&friends_lock);
+    int added = link_ids(intern(name1), intern(name2));
+    if (added && log_file) {
+        fprintf(log_file, "%s|%s\n", name1, name2);
+        fflush(log_file);
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return added;
+}
+
+// Copies up to max friends of name, in the order they were made. Returns how many.
+int friends_list(const char *name, char friends[][PLAYER_NAME_SIZE], int max) {
+    pthread_rwlock_rdlock(&friends_lock);
+    int id = find_id(name);
+    int count = 0;
+    if (id != NO_ID) {
+        const IdList *list = &adjacency[id];
+        for (; count < list->count && count < max; count++) {
+            memcpy(friends[count], names[list->ids[count]], PLAYER_NAME_SIZE);
+        }
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return count;
+}
+
+// Appends one line to the request log. Runs with friends_lock held for writing.
+static void log_request(const char *sender, const char *receiver, const char *mark) {
+    if (request_log) {
+        fprintf(request_log, "%s|%s%s\n", sender, receiver, mark);
+        fflush(request_log);
+        request_records++;
+    }
+}
+
+// Files a request from sender to receiver unless they are friends already, one
+// of them has asked the other, or receiver has max_pending requests waiting.
+// Checks and insertion happen under one lock, so that two reactors cannot both
+// pass the checks.
+FriendRequestStatus friends_request(const char *sender, const char *receiver, int max_pending) {
+    pthread_rwlock_wrlock(&friends_lock);
+    int sender_id = intern(sender);
+    int receiver_id = intern(receiver);
+    FriendRequestStatus status = FRIEND_REQUEST_SENT;
+    if (has_edge(sender_id, receiver_id)) {
+        status = FRIEND_REQUEST_ALREADY_FRIENDS;
+    } else if (find_request(sender_id, receiver_id) != NO_ID) {
+        status = FRIEND_REQUEST_DUPLICATE;
+    } else if (find_request(receiver_id, sender_id) != NO_ID) {
+        status = FRIEND_REQUEST_RECIPROCAL;
+    } else if (incoming[receiver_id].count >= max_pending) {
+        status = FRIEND_REQUEST_FULL;
+    } else {
+        add_request(sender_id, receiver_id);
+        log_request(sender, receiver, "");
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return status;
+}
+
+// Withdraws the request from sender to receiver, once accepted or declined.
+// Returns 1 if it was pending.
+int friends_drop_request(const char *sender, const char *receiver) {
+    pthread_rwlock_wrlock(&friends_lock);
+    int sender_id = find_id(sender);
+    int receiver_id = find_id(receiver);
+    int dropped = sender_id != NO_ID && receiver_id != NO_ID && drop_request(sender_id, receiver_id);
+    if (dropped) {
+        log_request(sender, receiver, "|-");
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return dropped;
+}
+
+// Copies the senders of up to max requests waiting for receiver, oldest
+// first. Returns how many.
+int friends_request_list(const char *receiver, char senders[][PLAYER_NAME_SIZE], int max) {
+    pthread_rwlock_rdlock(&friends_lock);
+    int id = find_id(receiver);
+    int count = 0;
+    if (id != NO_ID) {
+        for (int i = incoming[id].head; i != NO_ID && count < max; i = requests[i].next) {
+            memcpy(senders[count++], names[requests[i].sender], PLAYER_NAME_SIZE);
+        }
+    }
+    pthread_rwlock_unlock(&friends_lock);
+    return count;
+}
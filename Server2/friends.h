@@ -0,0 +1,48 @@
+#ifndef FRIENDS_H
+#define FRIENDS_H
+
+#include "players.h"
+
+// Process-wide friend graph, shared by all reactor threads. Names are
+// interned to small ids once; each friendship is then one entry of a hash set
+// of id pairs (membership in O(1)) and one entry in each player's adjacency
+// list (listing in O(degree)). FRIENDS_FILE is an append-only log of
+// "player|friend" lines, one per friendship, read back at startup. Older
+// files listing "player|friend,friend,..." load the same way.
+//
+// Pending friend requests live in the same module, on the same ids: a hash
+// index on the (sender, receiver) pair answers whether a request is pending,
+// and each receiver has its requests in a list, oldest first, with their
+// count. FRIEND_REQUESTS_FILE is their append-only log: "sender|receiver"
+// files a request, "sender|receiver|-" withdraws it. It is rewritten with the
+// pending requests alone at startup once withdrawn ones make up most of it.
+
+#define FRIENDS_FILE "Database/friends.txt"
+#define FRIEND_REQUESTS_FILE      "Database/friend_requests.txt"
+#define FRIEND_REQUESTS_TEMP_FILE "Database/friend_requests_tmp.txt"
+
+typedef enum {
+    FRIEND_REQUEST_SENT,
+    FRIEND_REQUEST_ALREADY_FRIENDS,
+    FRIEND_REQUEST_DUPLICATE,  // Sender already asked receiver
+    FRIEND_REQUEST_RECIPROCAL, // Receiver already asked sender
+    FRIEND_REQUEST_FULL        // Receiver has too many requests waiting
+} FriendRequestStatus;
+
+int friends_open(void);
+
+void friends_close(void);
+
+int friends_are(const char *name1, const char *name2);
+
+int friends_add(const char *name1, const char *name2);
+
+int friends_list(const char *name, char friends[][PLAYER_NAME_SIZE], int max);
+
+FriendRequestStatus friends_request(const char *sender, const char *receiver, int max_pending);
+
+int friends_drop_request(const char *sender, const char *receiver);
+
+int friends_request_list(const char *receiver, char senders[][PLAYER_NAME_SIZE], int max);
+
+#endif /* FRIENDS_H */
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "leaderboard.h"
+
+typedef struct {
+    LeaderNode *next;
+    int span; // Entries from this node to next, next included (to the end if next is NULL)
+} LeaderLink;
+
+struct LeaderNode {
+    int id;
+    int elo;
+    int levels;
+    LeaderLink links[]; // One per level of the node
+};
+
+static LeaderNode *new_node(int levels, int id, int elo) {
+    LeaderNode *node = malloc(sizeof(LeaderNode) + levels * sizeof(LeaderLink));
+    if (!node) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    node->id = id;
+    node->elo = elo;
+    node->levels = levels;
+    return node;
+}
+
+// Whether a node with (elo, id) goes after node
+static int goes_after(const LeaderNode *node, int elo, int id) {
+    return node->elo > elo || (node->elo == elo && node->id < id);
+}
+
+// Each level holds a quarter of the nodes of the level below
+static int random_level(Leaderboard *board) {
+    board->rng ^= board->rng << 13;
+    board->rng ^= board->rng >> 7;
+    board->rng ^= board->rng << 17;
+    int level = 1;
+    for (uint64_t bits = board->rng; (bits & 3) == 0 && level < LEADERBOARD_MAX_LEVEL; bits >>= 2) {
+        level++;
+    }
+    return level;
+}
+
+void leaderboard_init(Leaderboard *board) {
+    memset(board, 0, sizeof(*board));
+    board->head = new_node(LEADERBOARD_MAX_LEVEL, -1, 0);
+    for (int i = 0; i < LEADERBOARD_MAX_LEVEL; i++) {
+        board->head->links[i].next = NULL;
+        board->head->links[i].span = 0;
+    }
+    board->level = 1;
+    board->rng = 0x9E3779B97F4A7C15ULL;
+}
+
+void leaderboard_free(Leaderboard *board) {
+    LeaderNode *node = board->head;
+    while (node) {
+        LeaderNode *next = node->links[0].next;
+        free(node);
+        node = next;
+    }
+    free(board->nodes);
+    memset(board, 0, sizeof(*board));
+}
+
+// Fills update[i] with the last node of level i before (elo, id), and rank[i]
+// with the entries up to and including it
+static void find_before(const Leaderboard *board, int elo, int id,
+                        LeaderNode **update, int *rank) {
+    LeaderNode *node = board->head;
+    int passed = 0;
+    for (int i = board->level - 1; i >= 0; i--) {
+        while (node->links[i].next && goes_after(node->links[i].next, elo, id)) {
+            passed += node->links[i].span;
+            node = node->links[i].next;
+        }
+        update[i] = node;
+        rank[i] = passed;
+    }
+}
+
+static void unlink_node(Leaderboard *board, LeaderNode *target) {
+    LeaderNode *update[LEADERBOARD_MAX_LEVEL];
+    int rank[LEADERBOARD_MAX_LEVEL];
+    find_before(board, target->elo, target->id, update, rank);
+    for (int i = 0; i < board->level; i++) {
+        if (update[i]->links[i].next == target) {
+            update[i]->links[i].span += target->links[i].span - 1;
+            update[i]->links[i].next = target->links[i].next;
+        } else {
+            update[i]->links[i].span--;
+        }
+    }
+    while (board->level > 1 && !board->head->links[board->level - 1].next) {
+        board->level--;
+    }
+    board->count--;
+}
+
+static void link_node(Leaderboard *board, LeaderNode *node) {
+    int levels = node->levels;
+    LeaderNode *update[LEADERBOARD_MAX_LEVEL];
+    int rank[LEADERBOARD_MAX_LEVEL];
+    find_before(board, node->elo, node->id, update, rank);
+    if (levels > board->level) {
+        for (int i = board->level; i < levels; i++) {
+            update[i] = board->head;
+            rank[i] = 0;
+            board->head->links[i].next = NULL;
+            board->head->links[i].span = board->count;
+        }
+        board->level = levels;
+    }
+    for (int i = 0; i < levels; i++) {
+        node->links[i].next = update[i]->links[i].next;
+        update[i]->links[i].next = node;
+        node->links[i].span = update[i]->links[i].span - (rank[0] - rank[i]);
+        update[i]->links[i].span = rank[0] - rank[i] + 1;
+    }
+    for (int i = levels; i < board->level; i++) {
+        update[i]->links[i].span++;
+    }
+    board->count++;
+}
+
+// Inserts id with elo, or moves it to its new place
+void leaderboard_set(Leaderboard *board, int id, int elo) {
+    if (id >= board->capacity) {
+        int new_capacity = board->capacity ? board->capacity : 256;
+        while (new_capacity <= id) {
+            new_capacity *= 2;
+        }
+        LeaderNode **grown = realloc(board->nodes, new_capacity * sizeof(LeaderNode *));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(grown + board->capacity, 0, (new_capacity - board->capacity) * sizeof(LeaderNode *));
+        board->nodes = grown;
+        board->capacity = new_capacity;
+    }
+
+    LeaderNode *node = board->nodes[id];
+    if (node && node->elo == elo) {
+        return;
+    }
+    // A node keeps its height for life, so a move is an unlink and a relink
+    if (node) {
+        unlink_node(board, node);
+        node->elo = elo;
+    } else {
+        node = new_node(random_level(board), id, elo);
+        board->nodes[id] = node;
+    }
+    link_node(board, node);
+}
+
+// The 1-based rank of id, 0 if it is not on the board
+int leaderboard_rank(const Leaderboard *board, int id) {
+    if (id < 0 || id >= board->capacity || !board->nodes[id]) {
+        return 0;
+    }
+    const LeaderNode *target = board->nodes[id];
+    const LeaderNode *node = board->head;
+    int passed = 0;
+    for (int i = board->level - 1; i >= 0; i--) {
+        // Stop on the target itself, not just before it
+        while (node->links[i].next && (node->links[i].next == target ||
+               goes_after(node->links[i].next, target->elo, target->id))) {
+            passed += node->links[i].span;
+            node = node->links[i].next;
+        }
+        if (node == target) {
+            return passed;
+        }
+    }
+    return 0;
+}
+
+// Copies to ids the players ranked first (1-based) onwards, at most count of
+// them. Returns how many there were.
+int leaderboard_range(const Leaderboard *board, int first, int count, int *ids) {
+    if (first < 1 || first > board->count) {
+        return 0;
+    }
+    const LeaderNode *node = board->head;
+    int passed = 0;
+    for (int i = board->level - 1; i >= 0; i--) {
+        while (node->links[i].next && passed + node->links[i].span <= first) {
+            passed += node->links[i].span;
+            node = node->links[i].next;
+        }
+    }
+    int found = 0;
+    for (; node && found < count; node = node->links[0].next) {
+        ids[found++] = node->id;
+    }
+    return found;
+}
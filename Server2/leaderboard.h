@@ -0,0 +1,34 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+
+// Players ordered by rating, best first, ties in id order: a skip list whose
+// links also count the entries they jump over, so that the rank of a player
+// and the players at a given rank are found in O(log n), like a lookup.
+// Ids are small integers chosen by the caller (index in its own table).
+
+#define LEADERBOARD_MAX_LEVEL 32
+
+typedef struct LeaderNode LeaderNode;
+
+typedef struct {
+    LeaderNode *head;
+    LeaderNode **nodes; // By id, NULL if absent
+    int capacity;       // Entries of nodes
+    int count;
+    int level;          // Levels in use
+    uint64_t rng;
+} Leaderboard;
+
+void leaderboard_init(Leaderboard *board);
+
+void leaderboard_free(Leaderboard *board);
+
+void leaderboard_set(Leaderboard *board, int id, int elo);
+
+int leaderboard_rank(const Leaderboard *board, int id);
+
+int leaderboard_range(const Leaderboard *board, int first, int count, int *ids);
+
+#endif /* LEADERBOARD_H */
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lobby.h"
+
+#define NO_SOCK -1
+
+typedef struct {
+    int used;
+    int reactor_id;
+    int in_room;
+    uint64_t handle;
+    char name[32];
+    int next_named;  // Next entry in the same name bucket
+    int prev_idle;   // Neighbours in the list of players not in a game
+    int next_idle;
+} LobbyEntry;
+
+static pthread_rwlock_t lobby_lock = PTHREAD_RWLOCK_INITIALIZER;
+static LobbyEntry *entries = NULL; // Indexed by socket descriptor
+static int capacity = 0;
+static int *buckets = NULL;        // Name hash -> first entry, NO_SOCK if none
+static int bucket_mask = -1;
+static int count = 0;
+static int idle_head = NO_SOCK;    // Players not in a game, in arrival order
+static int idle_tail = NO_SOCK;
+
+// FNV-1a
+static uint32_t hash_name(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+static void bucket_insert(int sock) {
+    int *head = &buckets[hash_name(entries[sock].name) & bucket_mask];
+    entries[sock].next_named = *head;
+    *head = sock;
+}
+
+static void bucket_remove(int sock) {
+    int *link = &buckets[hash_name(entries[sock].name) & bucket_mask];
+    while (*link != sock) {
+        link = &entries[*link].next_named;
+    }
+    *link = entries[sock].next_named;
+}
+
+// Keeps at most one entry per bucket on average
+static void grow_buckets(void) {
+    int size = bucket_mask < 0 ? 64 : (bucket_mask + 1) * 2;
+    free(buckets);
+    buckets = malloc(size * sizeof(int));
+    if (!buckets) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(buckets, 0xFF, size * sizeof(int)); // NO_SOCK everywhere
+    bucket_mask = size - 1;
+    for (int sock = 0; sock < capacity; sock++) {
+        if (entries[sock].used) {
+            bucket_insert(sock);
+        }
+    }
+}
+
+static void idle_link(int sock) {
+    entries[sock].prev_idle = idle_tail;
+    entries[sock].next_idle = NO_SOCK;
+    if (idle_tail != NO_SOCK) {
+        entries[idle_tail].next_idle = sock;
+    } else {
+        idle_head = sock;
+    }
+    idle_tail = sock;
+}
+
+static void idle_unlink(int sock) {
+    LobbyEntry *entry = &entries[sock];
+    if (entry->prev_idle != NO_SOCK) {
+        entries[entry->prev_idle].next_idle = entry->next_idle;
+    } else {
+        idle_head = entry->next_idle;
+    }
+    if (entry->next_idle != NO_SOCK) {
+        entries[entry->next_idle].prev_idle = entry->prev_idle;
+    } else {
+        idle_tail = entry->prev_idle;
+    }
+}
+
+static void remove_entry(int sock) {
+    bucket_remove(sock);
+    if (!entries[sock].in_room) {
+        idle_unlink(sock);
+    }
+    entries[sock].used = 0;
+    count--;
+}
+
+void lobby_add(int sock, const char *name, int reactor_id, uint64_t handle) {
+    pthread_rwlock_wrlock(&lobby_lock);
+    if (sock >= capacity) {
+        int new_capacity = capacity ? capacity : 64;
+        while (new_capacity <= sock) {
+            new_capacity *= 2;
+        }
+        LobbyEntry *grown = realloc(entries, new_capacity * sizeof(LobbyEntry));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(grown + capacity, 0, (new_capacity - capacity) * sizeof(LobbyEntry));
+        entries = grown;
+        capacity = new_capacity;
+    }
+    if (entries[sock].used) {
+        remove_entry(sock);
+    }
+    if (bucket_mask < 0 || count + 1 > bucket_mask + 1) {
+        grow_buckets();
+    }
+
+    LobbyEntry *entry = &entries[sock];
+    entry->used = 1;
+    entry->reactor_id = reactor_id;
+    entry->handle = handle;
+    entry->in_room = 0;
+    strncpy(entry->name, name, sizeof(entry->name) - 1);
+    entry->name[sizeof(entry->name) - 1] = '\0';
+    bucket_insert(sock);
+    idle_link(sock);
+    count++;
+    pthread_rwlock_unlock(&lobby_lock);
+}
+
+void lobby_remove(int sock) {
+    pthread_rwlock_wrlock(&lobby_lock);
+    if (sock < capacity && entries[sock].used) {
+        remove_entry(sock);
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+}
+
+void lobby_move(int sock, int reactor_id, uint64_t handle) {
+    pthread_rwlock_wrlock(&lobby_lock);
+    if (sock < capacity) {
+        entries[sock].reactor_id = reactor_id;
+        entries[sock].handle = handle;
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+}
+
+void lobby_set_in_room(int sock, int in_room) {
+    pthread_rwlock_wrlock(&lobby_lock);
+    if (sock < capacity && entries[sock].used && entries[sock].in_room != !!in_room) {
+        entries[sock].in_room = !!in_room;
+        if (in_room) {
+            idle_unlink(sock);
+        } else {
+            idle_link(sock);
+        }
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+}
+
+// Looks up the owner of a logged-in socket. Returns 1 if there is one.
+int lobby_owner(int sock, int *reactor_id, uint64_t *handle) {
+    int found = 0;
+
+    pthread_rwlock_rdlock(&lobby_lock);
+    if (sock >= 0 && sock < capacity && entries[sock].used) {
+        *reactor_id = entries[sock].reactor_id;
+        *handle = entries[sock].handle;
+        found = 1;
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+    return found;
+}
+
+// Looks up a player who is not in a game. Returns 1 and its owner if found.
+int lobby_find(const char *name, int exclude_sock, int *reactor_id, uint64_t *handle) {
+    int found = 0;
+
+    pthread_rwlock_rdlock(&lobby_lock);
+    if (bucket_mask >= 0) {
+        for (int i = buckets[hash_name(name) & bucket_mask]; i != NO_SOCK; i = entries[i].next_named) {
+            if (!entries[i].in_room && i != exclude_sock && strcmp(entries[i].name, name) == 0) {
+                *reactor_id = entries[i].reactor_id;
+                *handle = entries[i].handle;
+                found = 1;
+                break;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+    return found;
+}
+
+// Appends one line per player who is not in a game, stopping once buffer is full
+void lobby_list(char *buffer, size_t size, int exclude_sock) {
+    size_t len = strlen(buffer);
+
+    pthread_rwlock_rdlock(&lobby_lock);
+    for (int i = idle_head; i != NO_SOCK && len + 1 < size; i = entries[i].next_idle) {
+        if (i != exclude_sock) {
+            len += snprintf(buffer + len, size - len, "%s\n", entries[i].name);
+        }
+    }
+    pthread_rwlock_unlock(&lobby_lock);
+}
@@ -0,0 +1,27 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Process-wide view of logged-in players, shared by all reactor threads.
+// Entries are keyed by socket descriptor, which is unique in the process, and
+// record the reactor owning the client together with its handle there. A hash
+// index on the name serves lookups, and the players not in a game are kept
+// in a list, so neither scans the descriptors.
+
+void lobby_add(int sock, const char *name, int reactor_id, uint64_t handle);
+
+void lobby_remove(int sock);
+
+void lobby_move(int sock, int reactor_id, uint64_t handle);
+
+void lobby_set_in_room(int sock, int in_room);
+
+int lobby_owner(int sock, int *reactor_id, uint64_t *handle);
+
+int lobby_find(const char *name, int exclude_sock, int *reactor_id, uint64_t *handle);
+
+void lobby_list(char *buffer, size_t size, int exclude_sock);
+
+#endif /* LOBBY_H */
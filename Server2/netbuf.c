@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include "netbuf.h"
+
+// Returns a buffer holding one reference, for the caller to fill in before pushing it
+SharedBuf *sharedbuf_alloc(size_t len) {
+    SharedBuf *buf = malloc(sizeof(SharedBuf) + len);
+    if (!buf) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    buf->refs = 1;
+    buf->len = len;
+    return buf;
+}
+
+// Adds a reference; the caller must already hold one
+SharedBuf *sharedbuf_retain(SharedBuf *buf) {
+    __atomic_add_fetch(&buf->refs, 1, __ATOMIC_RELAXED);
+    return buf;
+}
+
+// Drops a reference, freeing the buffer with the last one. The release makes the
+// thread that frees it see every other holder done with the bytes.
+void sharedbuf_release(SharedBuf *buf) {
+    if (buf && __atomic_sub_fetch(&buf->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(buf);
+    }
+}
+
+// Whether the caller holds the only reference, and so may write over the bytes
+int sharedbuf_exclusive(SharedBuf *buf) {
+    return __atomic_load_n(&buf->refs, __ATOMIC_ACQUIRE) == 1;
+}
+
+static void outq_append(OutQueue *queue, OutChunk *chunk) {
+    chunk->next = NULL;
+    if (queue->tail) {
+        queue->tail->next = chunk;
+    } else {
+        queue->head = chunk;
+    }
+    queue->tail = chunk;
+    queue->bytes += chunk->len;
+}
+
+static void outq_free_chunk(OutChunk *chunk) {
+    sharedbuf_release(chunk->shared);
+    free(chunk);
+}
+
+// Returns 0 when the queue is over its high-water mark and the data was dropped
+int outq_push(OutQueue *queue, const char *data, size_t len) {
+    if (len == 0) {
+        return 1;
+    }
+    if (queue->bytes + len > OUTQ_HIGH_WATER) {
+        return 0;
+    }
+
+    OutChunk *chunk = malloc(sizeof(OutChunk) + len);
+    if (!chunk) {
+        return 0;
+    }
+    chunk->len = len;
+    chunk->data = chunk->bytes;
+    chunk->shared = NULL;
+    memcpy(chunk->bytes, data, len);
+    outq_append(queue, chunk);
+    return 1;
+}
+
+// Queues a reference to buf instead of a copy of its bytes; same return as outq_push()
+int outq_push_shared(OutQueue *queue, SharedBuf *buf) {
+    if (buf->len == 0) {
+        return 1;
+    }
+    if (queue->bytes + buf->len > OUTQ_HIGH_WATER) {
+        return 0;
+    }
+
+    OutChunk *chunk = malloc(sizeof(OutChunk));
+    if (!chunk) {
+        return 0;
+    }
+    sharedbuf_retain(buf);
+    chunk->len = buf->len;
+    chunk->data = buf->data;
+    chunk->shared = buf;
+    outq_append(queue, chunk);
+    return 1;
+}
+
+// Sends as much as the socket accepts, coalescing queued messages into one writev().
+// Returns 1 when drained, 0 when the socket would block, -1 on error.
+int outq_flush(OutQueue *queue, int sock) {
+    while (queue->head) {
+        struct iovec iov[OUTQ_IOV_BATCH];
+        int count = 0;
+        size_t offset = queue->offset;
+
+        for (OutChunk *chunk = queue->head; chunk && count < OUTQ_IOV_BATCH; chunk = chunk->next) {
+            iov[count].iov_base = (char *)chunk->data + offset;
+            iov[count].iov_len = chunk->len - offset;
+            offset = 0;
+            count++;
+        }
+
+        ssize_t sent = writev(sock, iov, count);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return -1;
+        }
+
+        queue->bytes -= sent;
+        while (sent > 0) {
+            OutChunk *chunk = queue->head;
+            size_t left = chunk->len - queue->offset;
+            if ((size_t)sent < left) {
+                queue->offset += sent;
+                break;
+            }
+            sent -= left;
+            queue->head = chunk->next;
+            queue->offset = 0;
+            outq_free_chunk(chunk);
+        }
+        if (!queue->head) {
+            queue->tail = NULL;
+        }
+    }
+    return 1;
+}
+
+void outq_clear(OutQueue *queue) {
+    OutChunk *chunk = queue->head;
+    while (chunk) {
+        OutChunk *next = chunk->next;
+        outq_free_chunk(chunk);
+        chunk = next;
+    }
+    memset(queue, 0, sizeof(*queue));
+}
+
+// Reads whatever the socket holds into the free part of the ring with one readv().
+// Returns the number of bytes read, 0 on EOF, -1 on error (errno is set).
+int inring_recv(InRing *ring, int sock) {
+    unsigned used = ring->tail - ring->head;
+    unsigned space = INRING_SIZE - used;
+    if (space == 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    unsigned start = ring->tail & (INRING_SIZE - 1);
+    unsigned first = INRING_SIZE - start;
+    struct iovec iov[2];
+    int count = 1;
+
+    iov[0].iov_base = ring->data + start;
+    iov[0].iov_len = first < space ? first : space;
+    if (first < space) {
+        iov[1].iov_base = ring->data;
+        iov[1].iov_len = space - first;
+        count = 2;
+    }
+
+    ssize_t n = readv(sock, iov, count);
+    if (n > 0) {
+        ring->tail += n;
+    }
+    return n;
+}
+
+// Extracts the next newline-terminated command into line, without the trailing CR/LF.
+// Returns 1 when a line was extracted, 0 when no complete line is buffered yet,
+// -1 when the buffered line is longer than size allows.
+int inring_next_line(InRing *ring, char *line, size_t size) {
+    unsigned used = ring->tail - ring->head;
+    unsigned len = 0;
+
+    while (len < used && ring->data[(ring->head + len) & (INRING_SIZE - 1)] != '\n') {
+        len++;
+    }
+    if (len == used) {
+        return (used >= size) ? -1 : 0;
+    }
+    if (len >= size) {
+        return -1;
+    }
+
+    unsigned start = ring->head & (INRING_SIZE - 1);
+    unsigned first = INRING_SIZE - start;
+    if (len <= first) {
+        memcpy(line, ring->data + start, len);
+    } else {
+        memcpy(line, ring->data + start, first);
+        memcpy(line + first, ring->data, len - first);
+    }
+    ring->head += len + 1;
+
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+    line[len] = '\0';
+    return 1;
+}
+
+// Copies up to len buffered bytes into out without consuming them.
+// Returns the number of bytes copied.
+size_t inring_peek(const InRing *ring, char *out, size_t len) {
+    unsigned used = ring->tail - ring->head;
+    if (len > used) {
+        len = used;
+    }
+
+    unsigned start = ring->head & (INRING_SIZE - 1);
+    unsigned first = INRING_SIZE - start;
+    if (len <= first) {
+        memcpy(out, ring->data + start, len);
+    } else {
+        memcpy(out, ring->data + start, first);
+        memcpy(out + first, ring->data, len - first);
+    }
+    return len;
+}
+
+void inring_skip(InRing *ring, size_t len) {
+    unsigned used = ring->tail - ring->head;
+    ring->head += len < used ? len : used;
+}
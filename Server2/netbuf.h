@@ -0,0 +1,67 @@
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stddef.h>
+
+#define OUTQ_HIGH_WATER  (256 * 1024) // Queued bytes after which a client is considered stalled
+#define OUTQ_IOV_BATCH   64           // Chunks handed to a single writev()
+#define INRING_SIZE      4096         // Receive ring capacity, must be a power of two
+#define MAX_LINE         1024         // Longest command line accepted, newline included
+
+// Immutable bytes shared by every queue they were pushed to, freed with the last reference.
+// A migrating client takes its queued chunks to another reactor, which then releases
+// them while the builder may still push the buffer elsewhere, so the count is atomic.
+typedef struct {
+    int refs; // Only through the __atomic builtins
+    size_t len;
+    char data[];
+} SharedBuf;
+
+typedef struct OutChunk {
+    struct OutChunk *next;
+    size_t len;
+    const char *data;  // Points into bytes[] or into shared
+    SharedBuf *shared; // Referenced buffer, NULL if the bytes were copied
+    char bytes[];
+} OutChunk;
+
+// Outbound bytes waiting for a non-blocking socket to become writable
+typedef struct {
+    OutChunk *head;
+    OutChunk *tail;
+    size_t offset; // Bytes of head already sent
+    size_t bytes;  // Total bytes still queued
+} OutQueue;
+
+// Inbound bytes not yet framed into commands
+typedef struct {
+    char data[INRING_SIZE];
+    unsigned head; // Read position, free-running
+    unsigned tail; // Write position, free-running
+} InRing;
+
+SharedBuf *sharedbuf_alloc(size_t len);
+
+SharedBuf *sharedbuf_retain(SharedBuf *buf);
+
+void sharedbuf_release(SharedBuf *buf);
+
+int sharedbuf_exclusive(SharedBuf *buf);
+
+int outq_push(OutQueue *queue, const char *data, size_t len);
+
+int outq_push_shared(OutQueue *queue, SharedBuf *buf);
+
+int outq_flush(OutQueue *queue, int sock);
+
+void outq_clear(OutQueue *queue);
+
+int inring_recv(InRing *ring, int sock);
+
+int inring_next_line(InRing *ring, char *line, size_t size);
+
+size_t inring_peek(const InRing *ring, char *out, size_t len);
+
+void inring_skip(InRing *ring, size_t len);
+
+#endif /* NETBUF_H */
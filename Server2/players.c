@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "players.h"
+#include "leaderboard.h"
+
+#define INITIAL_SLOTS 1024 // Hash slots, always a power of two
+#define NO_PLAYER     -1
+
+static pthread_rwlock_t players_lock = PTHREAD_RWLOCK_INITIALIZER;
+static PlayerRating *players = NULL; // In registration order
+static int player_count = 0;
+static int player_capacity = 0;
+static int *slots = NULL;            // Open addressing, linear probing: index in players[] or NO_PLAYER
+static int slot_mask = 0;
+static Leaderboard leaderboard;       // Ids are indexes in players[]
+static uint64_t ratings_version = 1; // Bumped whenever the ranking may have changed
+static pthread_mutex_t wal_lock = PTHREAD_MUTEX_INITIALIZER; // Taken after players_lock, never before
+static FILE *wal = NULL;             // Both under wal_lock
+static int wal_records = 0;          // Lines appended since the last rotation
+
+// Background compaction: the reactors only append to the journal
+static pthread_mutex_t compact_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t compact_cond = PTHREAD_COND_INITIALIZER;
+static int compact_requested = 0;
+static int compactor_stopping = 0;
+static pthread_t compactor;
+
+// FNV-1a
+static uint64_t hash_name(const char *name) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+// The slot holding name, or the empty slot where it would go
+static int find_slot(const char *name) {
+    int slot = (int)(hash_name(name) & (uint64_t)slot_mask);
+    while (slots[slot] != NO_PLAYER && strcmp(players[slots[slot]].name, name) != 0) {
+        slot = (slot + 1) & slot_mask;
+    }
+    return slot;
+}
+
+static void rehash(int slot_count) {
+    free(slots);
+    slots = malloc(slot_count * sizeof(int));
+    if (!slots) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    memset(slots, 0xFF, slot_count * sizeof(int)); // NO_PLAYER everywhere
+    slot_mask = slot_count - 1;
+    for (int i = 0; i < player_count; i++) {
+        slots[find_slot(players[i].name)] = i;
+    }
+}
+
+static PlayerRating *lookup(const char *name) {
+    int index = slots[find_slot(name)];
+    return index == NO_PLAYER ? NULL : &players[index];
+}
+
+// Adds name with elo, or sets the rating of a known player. Returns the entry.
+static PlayerRating *upsert(const char *name, int elo) {
+    int slot = find_slot(name);
+    __atomic_add_fetch(&ratings_version, 1, __ATOMIC_RELEASE);
+    if (slots[slot] != NO_PLAYER) {
+        players[slots[slot]].elo = elo;
+        leaderboard_set(&leaderboard, slots[slot], elo);
+        return &players[slots[slot]];
+    }
+
+    if (player_count == player_capacity) {
+        int new_capacity = player_capacity ? player_capacity * 2 : 256;
+        PlayerRating *grown = realloc(players, new_capacity * sizeof(PlayerRating));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        players = grown;
+        player_capacity = new_capacity;
+    }
+    PlayerRating *player = &players[player_count];
+    strncpy(player->name, name, sizeof(player->name) - 1);
+    player->name[sizeof(player->name) - 1] = '\0';
+    player->elo = elo;
+    leaderboard_set(&leaderboard, player_count, elo);
+    slots[slot] = player_count++;
+
+    // Keep the table at most half full so that probe chains stay short
+    if (player_count * 2 > slot_mask + 1) {
+        rehash((slot_mask + 1) * 2);
+    }
+    return player;
+}
+
+// Reads "name elo" lines into the table; a journal line may hold several
+// pairs, applied together. A last line without its newline was cut short by
+// a crash while it was being appended, and is ignored.
+static void load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        if (!strchr(line, '\n')) {
+            continue;
+        }
+        char name[PLAYER_NAME_SIZE];
+        int elo;
+        int used;
+        for (char *pair = line; sscanf(pair, "%31s %d%n", name, &elo, &used) == 2; pair += used) {
+            upsert(name, elo);
+        }
+    }
+    fclose(file);
+}
+
+// Writes count ratings to PLAYERS_FILE. The new file replaces the old one in
+// a single rename, so a crash leaves one or the other, and the journals still
+// to be replayed on top of it.
+static int write_snapshot(const PlayerRating *list, int count) {
+    FILE *file = fopen(PLAYERS_TEMP_FILE, "w");
+    if (!file) {
+        perror("Failed to open temporary file for writing");
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s %d\n", list[i].name, list[i].elo);
+    }
+    if (fflush(file) != 0 || fsync(fileno(file)) != 0) {
+        perror("Failed to write the players checkpoint");
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    if (rename(PLAYERS_TEMP_FILE, PLAYERS_FILE) != 0) {
+        perror("Failed to rename temporary file to players database");
+        return -1;
+    }
+    return 0;
+}
+
+// Writes the table out and empties both journals. Runs with players_lock held
+// for writing, at startup and shutdown only.
+static void checkpoint(void) {
+    pthread_mutex_lock(&wal_lock);
+    if (write_snapshot(players, player_count) != 0) {
+        pthread_mutex_unlock(&wal_lock);
+        return;
+    }
+    unlink(PLAYERS_WAL_OLD);
+    FILE *empty = freopen(PLAYERS_WAL, "w", wal);
+    if (!empty) {
+        perror("Failed to reset the players journal");
+    }
+    wal = empty;
+    wal_records = 0;
+    pthread_mutex_unlock(&wal_lock);
+}
+
+// Merges the journal into the snapshot while the reactors keep appending.
+// Under the lock, only the journal is set aside as PLAYERS_WAL_OLD and the
+// table copied; the snapshot is written outside it. If a previous compaction
+// failed, PLAYERS_WAL_OLD still holds records the snapshot lacks and is left
+// in place: the new snapshot covers it, and the journal is replayed after it.
+static void compact(void) {
+    pthread_rwlock_wrlock(&players_lock);
+    // Appends still running finish first; the table already has their changes
+    pthread_mutex_lock(&wal_lock);
+    if (!wal) {
+        pthread_mutex_unlock(&wal_lock);
+        pthread_rwlock_unlock(&players_lock);
+        return;
+    }
+    if (access(PLAYERS_WAL_OLD, F_OK) != 0) {
+        fclose(wal);
+        if (rename(PLAYERS_WAL, PLAYERS_WAL_OLD) != 0) {
+            perror("Failed to set the players journal aside");
+        }
+        wal = fopen(PLAYERS_WAL, "a");
+        if (!wal) {
+            perror("Failed to open the players journal");
+        }
+    }
+    wal_records = 0; // A failed compaction is retried after as many records
+    int count = player_count;
+    PlayerRating *copy = malloc((count ? count : 1) * sizeof(PlayerRating));
+    if (!copy) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, players, count * sizeof(PlayerRating));
+    pthread_mutex_unlock(&wal_lock);
+    pthread_rwlock_unlock(&players_lock);
+
+    if (write_snapshot(copy, count) == 0) {
+        unlink(PLAYERS_WAL_OLD);
+    }
+    free(copy);
+}
+
+static void *compactor_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&compact_lock);
+    while (!compactor_stopping) {
+        if (!compact_requested) {
+            pthread_cond_wait(&compact_cond, &compact_lock);
+            continue;
+        }
+        compact_requested = 0;
+        pthread_mutex_unlock(&compact_lock);
+        compact();
+        pthread_mutex_lock(&compact_lock);
+    }
+    pthread_mutex_unlock(&compact_lock);
+    return NULL;
+}
+
+// Releases players_lock, then appends one journal line formatted while it was
+// held. wal_lock is taken first, so records reach the journal in the order
+// their changes reached the table, while lookups no longer wait for the write.
+// The line reaches the kernel before the caller goes on, so it survives the
+// server process, but nothing is fsynced: a machine crash or power loss may
+// lose the last records. A full journal is handed to the compactor.
+static void unlock_and_log(const char *line) {
+    pthread_mutex_lock(&wal_lock);
+    pthread_rwlock_unlock(&players_lock);
+    if (wal) {
+        fputs(line, wal);
+        fflush(wal);
+        if (++wal_records == PLAYERS_COMPACT_RECORDS) {
+            pthread_mutex_lock(&compact_lock);
+            compact_requested = 1;
+            pthread_cond_signal(&compact_cond);
+            pthread_mutex_unlock(&compact_lock);
+        }
+    }
+    pthread_mutex_unlock(&wal_lock);
+}
+
+// Loads the last snapshot, replays the journals over it and starts the compactor
+int players_open(void) {
+    pthread_rwlock_wrlock(&players_lock);
+    rehash(INITIAL_SLOTS);
+    leaderboard_init(&leaderboard);
+    load(PLAYERS_FILE);
+    load(PLAYERS_WAL_OLD);
+    load(PLAYERS_WAL);
+
+    wal = fopen(PLAYERS_WAL, "a");
+    if (!wal) {
+        perror("Failed to open the players journal");
+        pthread_rwlock_unlock(&players_lock);
+        return -1;
+    }
+    // Fold whatever was replayed into a fresh snapshot
+    checkpoint();
+    pthread_rwlock_unlock(&players_lock);
+
+    compactor_stopping = 0;
+    if (pthread_create(&compactor, NULL, compactor_main, NULL) != 0) {
+        perror("pthread_create()");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+void players_close(void) {
+    pthread_mutex_lock(&compact_lock);
+    compactor_stopping = 1;
+    pthread_cond_signal(&compact_cond);
+    pthread_mutex_unlock(&compact_lock);
+    pthread_join(compactor, NULL);
+
+    pthread_rwlock_wrlock(&players_lock);
+    if (wal) {
+        checkpoint();
+        pthread_mutex_lock(&wal_lock);
+        if (wal) {
+            fclose(wal);
+        }
+        wal = NULL;
+        pthread_mutex_unlock(&wal_lock);
+    }
+    leaderboard_free(&leaderboard);
+    free(players);
+    free(slots);
+    players = NULL;
+    slots = NULL;
+    player_count = 0;
+    player_capacity = 0;
+    pthread_rwlock_unlock(&players_lock);
+}
+
+// Registers name with the default rating. Returns 1 if it is new.
+int players_add(const char *name) {
+    pthread_rwlock_wrlock(&players_lock);
+    int added = lookup(name) == NULL;
+    if (!added) {
+        pthread_rwlock_unlock(&players_lock);
+        return 0;
+    }
+    PlayerRating *player = upsert(name, PLAYERS_DEFAULT_ELO);
+    char line[64];
+    snprintf(line, sizeof(line), "%s %d\n", player->name, player->elo);
+    unlock_and_log(line);
+    return 1;
+}
+
+int players_exists(const char *name) {
+    pthread_rwlock_rdlock(&players_lock);
+    int exists = lookup(name) != NULL;
+    pthread_rwlock_unlock(&players_lock);
+    return exists;
+}
+
+// The rating of name, 0 if nobody has that name
+int players_elo(const char *name) {
+    pthread_rwlock_rdlock(&players_lock);
+    PlayerRating *player = lookup(name);
+    int elo = player ? player->elo : 0;
+    pthread_rwlock_unlock(&players_lock);
+    return elo;
+}
+
+// Moves the winner up and the loser down by delta, as one journal record so
+// that recovery never applies half a result. Unknown names start from the default.
+void players_record_result(const char *winner, const char *loser, int delta) {
+    pthread_rwlock_wrlock(&players_lock);
+    PlayerRating *player = lookup(winner);
+    PlayerRating *won = upsert(winner, (player ? player->elo : PLAYERS_DEFAULT_ELO) + delta);
+    char line[128];
+    // Formatted now: adding the loser may move the table
+    int len = snprintf(line, sizeof(line), "%s %d ", won->name, won->elo);
+    player = lookup(loser);
+    PlayerRating *lost = upsert(loser, (player ? player->elo : PLAYERS_DEFAULT_ELO) - delta);
+    snprintf(line + len, sizeof(line) - len, "%s %d\n", lost->name, lost->elo);
+    unlock_and_log(line);
+}
+
+// Copies to out the players ranked first (1-based) onwards, best first, at
+// most count (up to PLAYERS_RANGE_MAX) of them. Returns how many there were.
+// Ties keep registration order.
+int players_range(int first, PlayerRating *out, int count) {
+    int ids[PLAYERS_RANGE_MAX];
+    if (count > PLAYERS_RANGE_MAX) {
+        count = PLAYERS_RANGE_MAX;
+    }
+    pthread_rwlock_rdlock(&players_lock);
+    int found = leaderboard_range(&leaderboard, first, count, ids);
+    for (int i = 0; i < found; i++) {
+        out[i] = players[ids[i]];
+    }
+    pthread_rwlock_unlock(&players_lock);
+    return found;
+}
+
+// The 1-based rank of name, 0 if nobody has that name
+int players_rank(const char *name) {
+    pthread_rwlock_rdlock(&players_lock);
+    PlayerRating *player = lookup(name);
+    int rank = player ? leaderboard_rank(&leaderboard, (int)(player - players)) : 0;
+    pthread_rwlock_unlock(&players_lock);
+    return rank;
+}
+
+int players_count(void) {
+    pthread_rwlock_rdlock(&players_lock);
+    int count = player_count;
+    pthread_rwlock_unlock(&players_lock);
+    return count;
+}
+
+// Changes whenever a rating or the set of players changes, so that callers
+// can keep rankings they formatted until then
+uint64_t players_version(void) {
+    return __atomic_load_n(&ratings_version, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,53 @@
+#ifndef PLAYERS_H
+#define PLAYERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Process-wide registry of every player who ever logged in, with their ELO,
+// shared by all reactor threads. It is read once at startup: the last
+// snapshot (PLAYERS_FILE), then the journals of the changes made since
+// (PLAYERS_WAL_OLD, PLAYERS_WAL). Snapshot lines are "name elo"; a journal
+// line holds one such pair per player it changes, with their new rating, so
+// replaying it twice does no harm. Lookups go through a hash index and never
+// touch the disk. Reactors only append to the journal, after releasing the
+// registry lock; a background thread merges it into the snapshot. Journal
+// lines are flushed to the kernel but not fsynced: they survive the server
+// crashing, not the machine. The ranking is kept up to date in a
+// Leaderboard as ratings change.
+
+#define PLAYERS_FILE        "Database/players.txt"
+#define PLAYERS_TEMP_FILE   "Database/players_temp.txt"
+#define PLAYERS_WAL         "Database/players.wal"
+#define PLAYERS_WAL_OLD     "Database/players.wal.old" // Journal being merged into the snapshot
+#define PLAYER_NAME_SIZE    32
+#define PLAYERS_DEFAULT_ELO 1000
+#define PLAYERS_RANGE_MAX   64   // Players copied by one players_range() call
+#define PLAYERS_COMPACT_RECORDS 4096 // Journal lines after which the compactor rewrites PLAYERS_FILE
+
+typedef struct {
+    char name[PLAYER_NAME_SIZE];
+    int elo;
+} PlayerRating;
+
+int players_open(void);
+
+void players_close(void);
+
+int players_add(const char *name);
+
+int players_exists(const char *name);
+
+int players_elo(const char *name);
+
+void players_record_result(const char *winner, const char *loser, int delta);
+
+int players_range(int first, PlayerRating *out, int count);
+
+int players_rank(const char *name);
+
+int players_count(void);
+
+uint64_t players_version(void);
+
+#endif /* PLAYERS_H */
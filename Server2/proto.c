@@ -0,0 +1,72 @@
+#include <string.h>
+
+#include "proto.h"
+
+void proto_header(char *out, int opcode, size_t len) {
+    out[0] = (char)opcode;
+    out[1] = (char)((len >> 8) & 0xFF);
+    out[2] = (char)(len & 0xFF);
+}
+
+// Seeds never exceed MAX_GRAINS, so every pit and score fits in a byte
+size_t proto_board(char *out, const Plateau *plateau) {
+    proto_header(out, OP_BOARD, CASES + 2);
+    for (int i = 0; i < CASES; i++) {
+        out[PROTO_HEADER + i] = (char)plateau->cases[i];
+    }
+    out[PROTO_HEADER + CASES] = (char)plateau->score[0];
+    out[PROTO_HEADER + CASES + 1] = (char)plateau->score[1];
+    return PROTO_BOARD_SIZE;
+}
+
+size_t proto_move(char *out, int seat, int pit) {
+    proto_header(out, OP_MOVE, 2);
+    out[PROTO_HEADER] = (char)seat;
+    out[PROTO_HEADER + 1] = (char)pit;
+    return PROTO_HEADER + 2;
+}
+
+size_t proto_turn(char *out, int seat, int your_seat) {
+    proto_header(out, OP_TURN, 2);
+    out[PROTO_HEADER] = (char)seat;
+    out[PROTO_HEADER + 1] = (char)your_seat;
+    return PROTO_HEADER + 2;
+}
+
+size_t proto_result(char *out, int winner, int reason) {
+    proto_header(out, OP_RESULT, 2);
+    out[PROTO_HEADER] = (char)winner;
+    out[PROTO_HEADER + 1] = (char)reason;
+    return PROTO_HEADER + 2;
+}
+
+size_t proto_hello(char *out) {
+    proto_header(out, OP_HELLO, 1);
+    out[PROTO_HEADER] = PROTO_VERSION;
+    return PROTO_HEADER + 1;
+}
+
+// Extracts the next complete frame from the ring into payload.
+// Returns 1 when a frame was extracted, 0 when the frame is not complete yet,
+// -1 when its payload is larger than size allows.
+int proto_next_frame(InRing *ring, int *opcode, char *payload, size_t size, size_t *len) {
+    unsigned char header[PROTO_HEADER];
+    if (inring_peek(ring, (char *)header, PROTO_HEADER) < PROTO_HEADER) {
+        return 0;
+    }
+
+    size_t length = ((size_t)header[1] << 8) | header[2];
+    if (length > size) {
+        return -1;
+    }
+    if (ring->tail - ring->head < PROTO_HEADER + length) {
+        return 0;
+    }
+
+    inring_skip(ring, PROTO_HEADER);
+    inring_peek(ring, payload, length);
+    inring_skip(ring, length);
+    *opcode = header[0];
+    *len = length;
+    return 1;
+}
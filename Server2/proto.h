@@ -0,0 +1,50 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <stddef.h>
+
+#include "awale.h"
+#include "netbuf.h"
+
+// Binary protocol for bots and spectator relays. A client opts in by sending
+// PROTO_HELLO_LINE as its very first line; from then on both directions carry
+// frames: opcode (1 byte), payload length (2 bytes, big-endian), payload.
+// The lobby menu keeps working through TEXT frames, one command per frame.
+
+#define PROTO_HELLO_LINE  "AWALE/1 BINARY"
+#define PROTO_VERSION     1
+#define PROTO_HEADER      3
+#define PROTO_NO_SEAT     0xFF // Seat byte meaning "nobody" (observers, no winner)
+
+typedef enum {
+    OP_HELLO  = 0x00, // S->C [version], first frame after a successful login
+    OP_TEXT   = 0x01, // C->S one command line; S->C text meant for people
+    OP_MOVE   = 0x02, // C->S [pit 1-6, 0 leaves the game]; S->C [seat, pit 1-6]
+    OP_BOARD  = 0x03, // S->C [12 pits, score seat 0, score seat 1]
+    OP_TURN   = 0x04, // S->C [seat to move, your seat or PROTO_NO_SEAT]
+    OP_RESULT = 0x05  // S->C [winner seat or PROTO_NO_SEAT, reason]
+} ProtoOpcode;
+
+typedef enum {
+    RESULT_CAPTURE = 0, // The winner captured more than half the seeds
+    RESULT_FORFEIT = 1, // The loser left or disconnected
+    RESULT_NO_MOVES = 2 // A player could not move; each side kept its own seeds
+} ProtoResult;
+
+#define PROTO_BOARD_SIZE  (PROTO_HEADER + CASES + 2)
+
+void proto_header(char *out, int opcode, size_t len);
+
+size_t proto_board(char *out, const Plateau *plateau);
+
+size_t proto_move(char *out, int seat, int pit);
+
+size_t proto_turn(char *out, int seat, int your_seat);
+
+size_t proto_result(char *out, int winner, int reason);
+
+size_t proto_hello(char *out);
+
+int proto_next_frame(InRing *ring, int *opcode, char *payload, size_t size, size_t *len);
+
+#endif /* PROTO_H */
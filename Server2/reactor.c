@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "reactor.h"
+
+// Each reactor thread owns its connections and rooms; other threads only
+// talk to it through this mailbox, which wakes its epoll loop via an eventfd.
+typedef struct {
+    pthread_mutex_t lock;
+    Envelope *head;
+    Envelope *tail;
+    int wake_fd;
+} Mailbox;
+
+static Mailbox *mailboxes = NULL;
+static int num_reactors = 0;
+static volatile int stopping = 0;
+
+void reactor_init(int count) {
+    mailboxes = calloc(count, sizeof(Mailbox));
+    if (!mailboxes) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        pthread_mutex_init(&mailboxes[i].lock, NULL);
+        mailboxes[i].wake_fd = eventfd(0, EFD_NONBLOCK);
+        if (mailboxes[i].wake_fd == -1) {
+            perror("eventfd()");
+            exit(EXIT_FAILURE);
+        }
+    }
+    num_reactors = count;
+}
+
+int reactor_count(void) {
+    return num_reactors;
+}
+
+int reactor_wake_fd(int reactor_id) {
+    return mailboxes[reactor_id].wake_fd;
+}
+
+static void wake(Mailbox *mailbox) {
+    uint64_t one = 1;
+    if (write(mailbox->wake_fd, &one, sizeof(one)) < 0) {
+        // Counter already pending, the reactor is awake anyway
+    }
+}
+
+void reactor_post(int reactor_id, Envelope *envelope) {
+    Mailbox *mailbox = &mailboxes[reactor_id];
+    int was_empty;
+
+    envelope->next = NULL;
+    pthread_mutex_lock(&mailbox->lock);
+    was_empty = (mailbox->head == NULL);
+    if (mailbox->tail) {
+        mailbox->tail->next = envelope;
+    } else {
+        mailbox->head = envelope;
+    }
+    mailbox->tail = envelope;
+    pthread_mutex_unlock(&mailbox->lock);
+
+    if (was_empty) {
+        wake(mailbox);
+    }
+}
+
+// Detaches every queued envelope, oldest first
+Envelope *reactor_take_all(int reactor_id) {
+    Mailbox *mailbox = &mailboxes[reactor_id];
+    uint64_t count;
+
+    if (read(mailbox->wake_fd, &count, sizeof(count)) < 0) {
+        // Nothing signalled, the list may still hold envelopes
+    }
+
+    pthread_mutex_lock(&mailbox->lock);
+    Envelope *head = mailbox->head;
+    mailbox->head = NULL;
+    mailbox->tail = NULL;
+    pthread_mutex_unlock(&mailbox->lock);
+    return head;
+}
+
+void reactor_stop_all(void) {
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < num_reactors; i++) {
+        wake(&mailboxes[i]);
+    }
+}
+
+int reactor_stopping(void) {
+    return __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+}
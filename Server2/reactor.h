@@ -0,0 +1,23 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+// Intrusive link for anything posted to a reactor's mailbox
+typedef struct Envelope {
+    struct Envelope *next;
+} Envelope;
+
+void reactor_init(int count);
+
+int reactor_count(void);
+
+int reactor_wake_fd(int reactor_id);
+
+void reactor_post(int reactor_id, Envelope *envelope);
+
+Envelope *reactor_take_all(int reactor_id);
+
+void reactor_stop_all(void);
+
+int reactor_stopping(void);
+
+#endif /* REACTOR_H */
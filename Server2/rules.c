@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "rules.h"
+#include "zobrist.h"
+
+#define CAMP_SIZE   (CASES / 2)
+#define BYTE_HIGHS  0x0000808080808080ULL // High bit of each of the 6 pit bytes
+#define BYTE_LOWS   0x00007F7F7F7F7F7FULL // Adding this sets the high bit of non-zero pits
+
+// Pit i of a camp needs at least 6 - i seeds to reach the other camp. Adding
+// 128 - (6 - i) to byte i sets its high bit exactly when it does.
+#define FEED_BIAS   0x00007F7E7D7C7B7AULL
+
+// The 6 pits of joueur's camp, pit i in byte i
+static uint64_t load_camp(const Board *board, int joueur) {
+    uint64_t camp = 0;
+    memcpy(&camp, board->pits + joueur * CAMP_SIZE, CAMP_SIZE);
+    return camp;
+}
+
+// Gathers the high bit of bytes 0-5 into bits 0-5. Each byte lands in the top
+// byte at its own bit, and no two partial products overlap, so nothing carries.
+static int gather_highs(uint64_t highs) {
+    return (int)((((highs & BYTE_HIGHS) >> 7) * 0x0102040810204080ULL) >> 56) & 0x3F;
+}
+
+static int camp_seeds(const Board *board, int joueur) {
+    int seeds = 0;
+    for (int i = 0; i < CAMP_SIZE; i++) {
+        seeds += board->pits[joueur * CAMP_SIZE + i];
+    }
+    return seeds;
+}
+
+// Bit i is set when pit i (0-5) of joueur's camp may be played. No branches
+// and no loop over the pits: one add per rule on the whole camp.
+int rules_legal_mask(const Board *board, int joueur) {
+    uint64_t camp = load_camp(board, joueur);
+    int non_empty = gather_highs(camp + BYTE_LOWS);
+    int feeding = gather_highs(camp + FEED_BIAS);
+    int starving = load_camp(board, 1 - joueur) == 0;
+
+    return non_empty & (starving ? feeding : 0x3F);
+}
+
+// Plays a legal move: sows, then captures backwards from the last seed while it
+// lies in the opponent's camp on 2 or 3 seeds, unless that would take them all.
+// With a key, every pit and score that changed and the side to move are
+// rehashed into it. Returns the number of seeds captured.
+static inline int play(Board *board, int joueur, int pit, uint64_t *key) {
+    int last = key ? board_sow_keyed(board, joueur * CAMP_SIZE + pit, key)
+                   : board_sow(board, joueur * CAMP_SIZE + pit);
+    int first = (1 - joueur) * CAMP_SIZE; // Opponent's camp
+    int end = last;
+    int captured = 0;
+
+    if (key) {
+        *key ^= zobrist_side;
+    }
+    while (end >= first && end < first + CAMP_SIZE &&
+           (board->pits[end] == 2 || board->pits[end] == 3)) {
+        captured += board->pits[end];
+        end--;
+    }
+    if (captured == 0 || captured == camp_seeds(board, 1 - joueur)) {
+        return 0; // Nothing to take, or a grand slam
+    }
+
+    for (int i = last; i > end; i--) {
+        if (key) {
+            *key ^= zobrist_pits[i][board->pits[i]] ^ zobrist_pits[i][0];
+        }
+        board->pits[i] = 0;
+    }
+    if (key) {
+        *key ^= zobrist_scores[joueur][board->score[joueur]] ^ zobrist_scores[joueur][board->score[joueur] + captured];
+    }
+    board->score[joueur] += captured;
+    return captured;
+}
+
+int rules_play(Board *board, int joueur, int pit) {
+    return play(board, joueur, pit, NULL);
+}
+
+int rules_play_keyed(Board *board, int joueur, int pit, uint64_t *key) {
+    return play(board, joueur, pit, key);
+}
+
+// Tells whether the game is over with joueur to move. When it ends because
+// joueur cannot move, the seeds left on the board go to their camp's owner.
+int rules_game_over(Board *board, int joueur) {
+    if (board->score[0] > MAX_GRAINS / 2 || board->score[1] > MAX_GRAINS / 2) {
+        return 1;
+    }
+    if (rules_legal_mask(board, joueur) != 0) {
+        return 0;
+    }
+
+    board->score[0] += camp_seeds(board, 0);
+    board->score[1] += camp_seeds(board, 1);
+    memset(board->pits, 0, CASES);
+    return 1;
+}
+
+// The winner of a finished game, or RULES_DRAW
+int rules_winner(const Board *board) {
+    if (board->score[0] == board->score[1]) {
+        return RULES_DRAW;
+    }
+    return board->score[0] > board->score[1] ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "awale.h"
+
+// Awalé rules on top of the Board kernel, shared by the server, the bots and
+// the analysis tools:
+//  - a move takes a non-empty pit of the mover's camp;
+//  - if the opponent's camp is empty, the move must put seeds into it;
+//  - a capture that would take every seed of the opponent is not made;
+//  - a player who cannot move ends the game, and each player then keeps the
+//    seeds left in their own camp;
+//  - more than half of the seeds wins, 24 each is a draw.
+
+#define RULES_DRAW -1
+
+int rules_legal_mask(const Board *board, int joueur);
+
+int rules_play(Board *board, int joueur, int pit);
+
+// Same as rules_play(), keeping a zobrist_key() of the position up to date
+int rules_play_keyed(Board *board, int joueur, int pit, uint64_t *key);
+
+int rules_game_over(Board *board, int joueur);
+
+int rules_winner(const Board *board);
+
+#endif /* RULES_H */
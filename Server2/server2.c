@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // accept4()
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
@@ -6,29 +7,134 @@
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <dirent.h> 
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/epoll.h>
 
 #include "server2.h"
 #include "client2.h"
 #include "awale.h"
+#include "reactor.h"
+#include "lobby.h"
+#include "proto.h"
+#include "timer.h"
+#include "rules.h"
+#include "bot.h"
+#include "egdb.h"
+#include "book.h"
+#include "zobrist.h"
+#include "players.h"
+#include "friends.h"
 
 #define MAX_BIO_LENGTH 256
 
 
 typedef struct {
     Plateau board;           // Awalé game board
-    int player_sockets[2];   // Socket descriptors of the two players
     int current_turn;        // Indicates which player’s turn it is (0 or 1)
-    int player_index[2];     // Index of the players in the clients array
-    int observers[MAX_CLIENTS]; // Socket descriptors of observers
+    ClientHandle players[2]; // Handles of the players in this reactor's clients slab
+    ClientHandle *observers; // Handles of the observers, in no particular order
     int observer_count;      // Number of observers
+    int observer_capacity;   // Allocated entries in observers, kept when the slot is recycled
     char game_file[256];     // File path for saving the game
     int friends_only;        // 1 if only friends can spectate, 0 otherwise
+    int bot_seat;            // Seat played by the built-in opponent, -1 if both are people
+    uint32_t generation;     // Bumped each time the slot is released
+    int active;              // 1 while a game is played in this slot
+    int prev_active;         // Neighbours in the active rooms list, -1 at the ends
+    int next_active;
+    int next_free;           // Next released slot, -1 at the end
 } GameRoom;
 
-GameRoom game_rooms[MAX_CLIENTS];
+static const char *player_name(GameRoom *game_room, int player);
+static void write_player_event(GameRoom *game_room, int player, const char *text, const char *frame, size_t len);
+static void send_room_event(int room_id, const char *text, const char *frame, size_t len);
+static void send_room_board(int room_id, const char *frame, size_t len);
+static SharedBuf *board_text(const Plateau *plateau);
+static void announce_turn(int room_id, const char *text);
+static int alloc_room(void);
+static GameRoom *room_from_id(int room_id);
+static void forfeit_game(int client_index);
+static void play_move(int room_id, int seat, int move);
+
+// Everything below is owned by one reactor thread; other threads reach it
+// only through messages (see handle_mailbox()).
+static __thread int reactor_id = 0;
+
+// Pool of room slots: released slots are recycled through a free list and
+// the slots in use are chained in an active list (see alloc_room()).
+static __thread GameRoom *game_rooms = NULL;
+static __thread int rooms_capacity = 0;
+static __thread int free_room = -1;    // Head of the free list, -1 if empty
+static __thread int active_rooms = -1; // Head of the active list, -1 if empty
+
+// Slab of client slots: a slot keeps its index for the whole connection and
+// released slots are recycled through a free list (see alloc_client_slot()).
+static __thread Client *clients = NULL;
+static __thread int clients_capacity = 0;
+static __thread int free_slot = -1;       // Head of the free list, -1 if empty
+static __thread int *client_of_fd = NULL; // Socket descriptor -> slot in clients[], -1 if none
+static __thread int fd_capacity = 0;
+static __thread int epoll_fd = -1;
+static __thread ClientHandle *pending_clients = NULL; // Clients with queued output or a pending close
+static __thread int pending_count = 0;
+static __thread int pending_capacity = 0;
+static __thread TimerHeap timers;       // Login deadlines, tokens are client handles
+
+// Boards recently rendered as text, indexed by their Zobrist key. Observers
+// joining and rooms reaching an already rendered position reuse the bytes.
+typedef struct {
+    Board board;
+    SharedBuf *text; // NULL while the slot is empty
+} RenderedBoard;
+
+static __thread RenderedBoard render_cache[RENDER_CACHE_SIZE];
+
+// Rankings as last formatted by this reactor, valid until players_version() moves
+typedef struct {
+    uint64_t version; // 0 while empty
+    int page;         // 0 for the top 5 of the menu
+    char text[BUF_SIZE];
+} RankingPage;
+
+static __thread RankingPage ranking_cache[RANKING_CACHE_PAGES];
+
+// The flat-file database is shared by all reactors
+static pthread_mutex_t db_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef enum {
+    MSG_TEXT,         // Deliver text to a client owned by this reactor
+    MSG_DUEL_REQUEST, // Challenge a lobby client owned by this reactor
+    MSG_DUEL_ANSWER,  // The challenged client accepted (arg = hosting reactor) or refused (arg = -1)
+    MSG_ADOPT,        // Take over a migrating client, then run action
+    MSG_LIST_GAMES,   // Describe this reactor's rooms to the sender
+    MSG_GAMES_PART,   // One reactor's share of a room listing
+    MSG_BOT_MOVE      // The bot found its move (move) in the local room arg
+} MessageType;
+
+typedef enum {
+    ADOPT_ONLY,
+    ADOPT_DUEL,       // Start the game against the client's duel_handle, who accepted here
+    ADOPT_OBSERVE     // Observe the local room in arg
+} AdoptAction;
 
-static Client clients[MAX_CLIENTS];
-static int room_counter = 0;
+typedef struct {
+    Envelope link;
+    MessageType type;
+    int from_reactor;
+    ClientHandle from_handle;
+    char from_name[32];
+    ClientHandle to_handle;
+    char to_name[32];
+    int arg;
+    AdoptAction action;
+    int move;          // MSG_BOT_MOVE only
+    Client *client;    // MSG_ADOPT only, freed with the message: it is too big for every message to carry
+    char text[BUF_SIZE];
+} Message;
 
 
 void ensure_file_exists(const char *filename) {
@@ -50,9 +156,11 @@ static void init(void) {
         exit(EXIT_FAILURE);
     }
 #endif
+    // A peer closing mid-write must surface as EPIPE, not kill the server
+    signal(SIGPIPE, SIG_IGN);
     ensure_file_exists("Database/friends.txt");
     ensure_file_exists("Database/friend_requests.txt");
-    ensure_file_exists("Database/players.txt");
+    ensure_file_exists(PLAYERS_FILE);
     ensure_file_exists("Database/bios.txt");
 }
 
@@ -62,14 +170,10 @@ static void end(void) {
 #endif
 }
 
-static void send_player_list(Client *clients, int actual, int client_index) {
+static void send_player_list(Client *clients, int client_index) {
     char buffer[BUF_SIZE] = "Connected clients:\n";
-    for (int i = 0; i < actual; i++) {
-        if (clients[i].in_room == 0 && i != client_index) {
-            strncat(buffer, clients[i].name, sizeof(buffer) - strlen(buffer) - 1);
-            strncat(buffer, "\n", sizeof(buffer) - strlen(buffer) - 1);
-        }
-    }
+    // Players on every reactor, not just the ones sharing this thread
+    lobby_list(buffer, sizeof(buffer), clients[client_index].sock);
     write_client(clients[client_index].sock, buffer);
 }
 
@@ -90,7 +194,9 @@ static void send_welcome_message(Client *client) {
         "7. Send a friend request\n"
         "8. Accept/Decline Friend Request\n"
         "9. View Friends List\n"
-        "10. See top players\n"
+        "10. See top players and your rank\n"
+        "   Type 'top <page>' to browse the full ranking\n"
+        "11. Play against the bot\n"
         "Game Review Options:\n"
         " - Type 'list games' to view completed games.\n"
         " - Type 'replay <filename>' to review a completed game.\n"
@@ -103,9 +209,11 @@ static void send_welcome_message(Client *client) {
 
 
 int fetch_bio(const char *name, char *bio, size_t bio_size) {
+    pthread_mutex_lock(&db_lock);
     FILE *file = fopen("Database/bios.txt", "r");
     if (!file) {
         perror("Failed to open bios file for reading");
+        pthread_mutex_unlock(&db_lock);
         return 0; // Indicate failure
     }
     char line[512];
@@ -117,20 +225,24 @@ int fetch_bio(const char *name, char *bio, size_t bio_size) {
             strncpy(bio, saved_bio, bio_size - 1);
             bio[bio_size - 1] = '\0'; // Ensure null-terminated string
             fclose(file);
+            pthread_mutex_unlock(&db_lock);
             return 1; // Indicate success
         }
     }
 
     fclose(file);
+    pthread_mutex_unlock(&db_lock);
     return 0; // Indicate failure (bio not found)
 }
 
 void set_bio(const char *name, const char *new_bio) {
+    pthread_mutex_lock(&db_lock);
     FILE *file = fopen("Database/bios.txt", "r+");
     if (!file) {
         file = fopen("Database/bios.txt", "w");
         if (!file) {
             perror("Failed to open bios file for writing");
+            pthread_mutex_unlock(&db_lock);
             return;
         }
     }
@@ -141,6 +253,7 @@ void set_bio(const char *name, const char *new_bio) {
     if (!temp_file) {
         perror("Failed to create temporary file");
         fclose(file);
+        pthread_mutex_unlock(&db_lock);
         return;
     }
 
@@ -170,17 +283,18 @@ void set_bio(const char *name, const char *new_bio) {
     // Replace original file with updated file
     remove("Database/bios.txt");
     rename(temp_filename, "Database/bios.txt");
+    pthread_mutex_unlock(&db_lock);
 }
 
 static void handle_set_bio(int client_index) {
     const char *prompt = "Enter your bio (max 10 lines, ASCII only):\n";
     write_client(clients[client_index].sock, prompt);
+    clients[client_index].state = STATE_SET_BIO;
+}
 
-    char buffer[MAX_BIO_LENGTH];
-    int n = read_client(clients[client_index].sock, buffer);
+static void complete_set_bio(int client_index, char *buffer) {
+    int n = strlen(buffer);
     if (n > 0) {
-        buffer[n] = '\0';
-
         // Check ASCII and line constraints
         int line_count = 0;
         for (int i = 0; i < n; i++) {
@@ -194,6 +308,9 @@ static void handle_set_bio(int client_index) {
             write_client(clients[client_index].sock, "Bio must not exceed 10 lines.\n");
             return;
         }
+        if (n >= MAX_BIO_LENGTH) {
+            buffer[MAX_BIO_LENGTH - 1] = '\0';
+        }
 
         // Save or update the bio in the file
         set_bio(clients[client_index].name, buffer);
@@ -204,21 +321,19 @@ static void handle_set_bio(int client_index) {
     }
 }
 
-static void handle_view_bio(int client_index, int actual) {
-    send_player_list(clients, actual, client_index);
+static void handle_view_bio(int client_index) {
+    send_player_list(clients, client_index);
     const char *prompt = "Enter the name of the player whose bio you want to view:\n";
     write_client(clients[client_index].sock, prompt);
+    clients[client_index].state = STATE_VIEW_BIO;
+}
 
-    char buffer[32];
-    int n = read_client(clients[client_index].sock, buffer);
-    if (n > 0) {
-        buffer[n] = '\0';
-        buffer[strcspn(buffer, "\n")] = '\0'; // Remove newline
-
+static void complete_view_bio(int client_index, const char *buffer) {
+    if (buffer[0] != '\0') {
         char bio[MAX_BIO_LENGTH];
         if (fetch_bio(buffer, bio, sizeof(bio))) {
             char bio_msg[512];
-            snprintf(bio_msg, sizeof(bio_msg), "Bio of %s:\n%s\n", buffer, bio);
+            snprintf(bio_msg, sizeof(bio_msg), "Bio of %.31s:\n%s\n", buffer, bio);
             write_client(clients[client_index].sock, bio_msg);
         } else {
             write_client(clients[client_index].sock, "Player not found or bio not set.\n");
@@ -229,35 +344,12 @@ static void handle_view_bio(int client_index, int actual) {
 }
 
 void add_player_to_registry(const char *player_name) {
-    FILE *file = fopen("Database/players.txt", "r+");
-    if (!file) {
-        perror("Failed to open players.txt");
-        return;
-    }
-
-    char name[32];
-    int elo;
-    while (fscanf(file, "%31s %d", name, &elo) == 2) { // Read both name and ELO
-        if (strcmp(name, player_name) == 0) {
-            fclose(file);
-            return; // Player already exists
-        }
-    }
-
-    // Move to the end of the file to add the new player
-    fseek(file, 0, SEEK_END);
-    fprintf(file, "%s %d\n", player_name, 1000); // Default ELO is 1000
-    fclose(file);
+    players_add(player_name);
 }
 
-static void handle_join_game(int client_index, int actual) {
+static void handle_join_game(int client_index) {
     char buffer[BUF_SIZE] = "Available clients for a duel:\n";
-    for (int i = 0; i < actual; i++) {
-        if (i != client_index && clients[i].in_room == 0) {
-            strncat(buffer, clients[i].name, sizeof(buffer) - strlen(buffer) - 1);
-            strncat(buffer, "\n", sizeof(buffer) - strlen(buffer) - 1);
-        }
-    }
+    lobby_list(buffer, sizeof(buffer), clients[client_index].sock);
 
     // Send list to the requesting client
     write_client(clients[client_index].sock, buffer);
@@ -271,48 +363,82 @@ static void handle_join_game(int client_index, int actual) {
     clients[client_index].waiting_for_response = 1;
 }
 
-static void send_duel_request(int requester_index, const char *target_name, int actual) {
-    char buffer[BUF_SIZE];
-    int target_index = -1;
-
-    for (int i = 0; i < actual; i++) {
-        if (strcmp(clients[i].name, target_name) == 0 && clients[i].in_room == 0) {
-            target_index = i;
-            break;
-        }
+static Message *new_message(MessageType type, int from_index) {
+    Message *msg = calloc(1, sizeof(Message));
+    if (!msg) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    msg->type = type;
+    msg->from_reactor = reactor_id;
+    msg->from_handle = NO_CLIENT;
+    msg->to_handle = NO_CLIENT;
+    if (from_index >= 0) {
+        msg->from_handle = handle_of(from_index);
+        strncpy(msg->from_name, clients[from_index].name, sizeof(msg->from_name) - 1);
     }
+    return msg;
+}
+
+// Text for a client that may live on another reactor
+static void post_text(int target_reactor, ClientHandle handle, const char *name, const char *text) {
+    Message *msg = new_message(MSG_TEXT, -1);
+    msg->to_handle = handle;
+    strncpy(msg->to_name, name, sizeof(msg->to_name) - 1);
+    strncpy(msg->text, text, sizeof(msg->text) - 1);
+    reactor_post(target_reactor, &msg->link);
+}
+
+static void send_duel_request(int requester_index, const char *target_name) {
+    char buffer[BUF_SIZE];
+    int target_reactor;
+    ClientHandle target_handle;
 
-    if (target_index == -1) {
+    if (!lobby_find(target_name, clients[requester_index].sock, &target_reactor, &target_handle)) {
         snprintf(buffer, BUF_SIZE, "Player %s is not available for a duel.\n", target_name);
         write_client(clients[requester_index].sock, buffer);
     } else {
-        snprintf(buffer, BUF_SIZE, "%s has challenged you to a duel! Type 'accept' to join, or 'refuse' to decline and go back", clients[requester_index].name);
-        write_client(clients[target_index].sock, buffer);
+        // The target's reactor shows the challenge and remembers who sent it
+        Message *msg = new_message(MSG_DUEL_REQUEST, requester_index);
+        msg->to_handle = target_handle;
+        strncpy(msg->to_name, target_name, sizeof(msg->to_name) - 1);
+        reactor_post(target_reactor, &msg->link);
 
-        snprintf(buffer, BUF_SIZE, "Duel request sent to %s. Waiting for acceptance...\n", clients[target_index].name);
+        snprintf(buffer, BUF_SIZE, "Duel request sent to %s. Waiting for acceptance...\n", target_name);
         write_client(clients[requester_index].sock, buffer);
 
-        clients[requester_index].room_id = room_counter;
-        clients[target_index].room_id = room_counter;
-        room_counter++;
+        clients[requester_index].duel_reactor = target_reactor;
+        clients[requester_index].duel_handle = target_handle;
+        strncpy(clients[requester_index].duel_name, target_name, sizeof(clients[requester_index].duel_name) - 1);
     }
 }
 
 static void start_private_chat(int client1, int client2) {
+    // Both players now live on this reactor, which owns the room
+    int room_id = alloc_room();
+
     clients[client1].waiting_for_response = 0;
     clients[client2].waiting_for_response = 0;
+    clients[client1].duel_handle = NO_CLIENT;
+    clients[client2].duel_handle = NO_CLIENT;
+    if (room_id < 0) {
+        write_client(clients[client1].sock, "No game room is available right now.\n");
+        write_client(clients[client2].sock, "No game room is available right now.\n");
+        send_welcome_message(&clients[client1]);
+        send_welcome_message(&clients[client2]);
+        return;
+    }
+
     clients[client1].in_room = 1;
     clients[client2].in_room = 1;
-    
-    int room_id = clients[client1].room_id;
+    lobby_set_in_room(clients[client1].sock, 1);
+    lobby_set_in_room(clients[client2].sock, 1);
+    clients[client1].room_id = room_id;
     clients[client2].room_id = room_id;
 
-    GameRoom *game_room = &game_rooms[room_id];
-    memset(game_room, 0, sizeof(GameRoom));
-    game_room->player_sockets[0] = clients[client1].sock;
-    game_room->player_sockets[1] = clients[client2].sock;
-    game_room->player_index[0] = client1;
-    game_room->player_index[1] = client2;
+    GameRoom *game_room = room_from_id(room_id);
+    game_room->players[0] = handle_of(client1);
+    game_room->players[1] = handle_of(client2);
 
     game_room->current_turn = 0; // Start with player 0
 
@@ -323,36 +449,88 @@ static void start_private_chat(int client1, int client2) {
     char start_msg[BUF_SIZE];
     snprintf(start_msg, BUF_SIZE, "Awalé game started between %s and %s. %s goes first.\n You can use /1 to /6 to make a move or /-1 to exit.\n You can also chat with other player.\n Use /friends-only to make your room private.\n",
              clients[client1].name, clients[client2].name, clients[client1].name);
-    char *board_state = afficher_plateau(&game_room->board);  // Get board state
-    send_to_room(room_id, board_state);
+    char frame[PROTO_BOARD_SIZE];
+    size_t frame_len = proto_board(frame, &game_room->board);
+    send_room_board(room_id, frame, frame_len);
     save_game_state(game_room);
-    free(board_state);  // Free dynamically allocated memory
     write_client(clients[client1].sock, start_msg);
     write_client(clients[client2].sock, start_msg);
 
     // Inform the first player to make a move
-    write_client(game_room->player_sockets[0], "Your turn! Choose a pit (1-6):\n");
+    announce_turn(room_id, "Your turn! Choose a pit (1-6):\n");
 }
 
 
-int player_exists(const char *player_name) {
-    FILE *file = fopen("Database/players.txt", "r");
-    if (!file) {
-        perror("Failed to open players.txt");
-        return 0;
+// A bot search in flight; the job comes first so that done() gets the request back
+typedef struct {
+    BotJob job;
+    int reactor; // Owner of the room
+    int room_id;
+} BotRequest;
+
+// Runs on the bot thread: the move goes back to the room's reactor as a message
+static void bot_move_ready(BotJob *job) {
+    BotRequest *request = (BotRequest *)job;
+    Message *msg = new_message(MSG_BOT_MOVE, -1);
+    msg->arg = request->room_id;
+    msg->move = job->result.pit + 1;
+    reactor_post(request->reactor, &msg->link);
+    free(request);
+}
+
+// Hands the position to the bot threads; the reactor goes on serving everyone else
+static void request_bot_move(int room_id) {
+    GameRoom *game_room = room_from_id(room_id);
+    BotRequest *request = calloc(1, sizeof(BotRequest));
+    if (!request) {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
     }
+    board_from_plateau(&request->job.board, &game_room->board);
+    request->job.joueur = game_room->bot_seat;
+    request->job.budget_ms = BOT_MOVE_MS;
+    request->job.done = bot_move_ready;
+    request->reactor = reactor_id;
+    request->room_id = room_id;
+    bot_submit(&request->job);
+}
 
-    char name[32];
-    int elo;
-    while (fscanf(file, "%31s %d", name, &elo) == 2) { // Read both name and ELO
-        if (strcmp(name, player_name) == 0) {
-            fclose(file);
-            return 1; // Player exists
-        }
+// The client plays first against the bot, which takes the other seat
+static void start_bot_game(int client_index) {
+    int room_id = alloc_room();
+    if (room_id < 0) {
+        write_client(clients[client_index].sock, "No game room is available right now.\n");
+        send_welcome_message(&clients[client_index]);
+        return;
     }
 
-    fclose(file);
-    return 0; // Player does not exist
+    clients[client_index].in_room = 1;
+    clients[client_index].room_id = room_id;
+    lobby_set_in_room(clients[client_index].sock, 1);
+
+    GameRoom *game_room = room_from_id(room_id);
+    game_room->players[0] = handle_of(client_index);
+    game_room->players[1] = NO_CLIENT;
+    game_room->bot_seat = 1;
+    game_room->current_turn = 0;
+
+    init_plateau(&game_room->board);
+    initialize_game_file(game_room, clients[client_index].name, BOT_NAME);
+
+    char start_msg[BUF_SIZE];
+    snprintf(start_msg, BUF_SIZE, "Awalé game started between %s and %s. %s goes first.\n You can use /1 to /6 to make a move or /-1 to exit.\n Games against the bot do not change your ELO.\n",
+             clients[client_index].name, BOT_NAME, clients[client_index].name);
+    char frame[PROTO_BOARD_SIZE];
+    size_t frame_len = proto_board(frame, &game_room->board);
+    send_room_board(room_id, frame, frame_len);
+    save_game_state(game_room);
+    write_client(clients[client_index].sock, start_msg);
+
+    announce_turn(room_id, "Your turn! Choose a pit (1-6):\n");
+}
+
+int player_exists(const char *player_name) {
+    return players_exists(player_name);
 }
 
 //save game system
@@ -360,11 +538,12 @@ int player_exists(const char *player_name) {
 void initialize_game_file(GameRoom *game_room, const char *player1, const char *player2) {
     // Get the current time
     time_t now = time(NULL);
-    struct tm *t = localtime(&now);
+    struct tm t;
+    localtime_r(&now, &t);
 
     // Generate a timestamp in the format YYYYMMDD_HHMMSS
     char timestamp[20];
-    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", t);
+    strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &t);
 
     // Generate a unique file name with the timestamp
     snprintf(game_room->game_file, sizeof(game_room->game_file),"Database/Games/%s_vs_%s_%s.txt", player1, player2, timestamp);
@@ -395,150 +574,56 @@ void save_game_state(GameRoom *game_room) {
     fclose(file);
 }
 
-void finalize_game_file(GameRoom *game_room, const char *result) {
-    FILE *file = fopen(game_room->game_file, "a");
-    if (file == NULL) {
-        perror("Failed to open game file for finalizing");
+// Once few seeds are left, the game record gets the endgame database's verdict
+// after each move: replays then show where a player let the result slip
+static void annotate_endgame(GameRoom *game_room, const Board *board, int joueur) {
+    int rest;
+    if (!egdb_probe(board, joueur, &rest)) {
         return;
     }
 
-    fprintf(file, "Game Result: %s\n", result);
-    fclose(file);
-}
-
-//friend system
-
-int are_friends(const char *player1, const char *player2) {
-    FILE *file = fopen("Database/friends.txt", "r");
-    if (!file) {
-        perror("Failed to open friends.txt");
-        return 0; // Assume not friends if file doesn't exist
-    }
-
-    char line[64];
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_player = strtok(line, "|");
-        char *friend_list = strtok(NULL, "\n");
-
-        if (saved_player && friend_list &&
-            (strcmp(saved_player, player1) == 0 || strcmp(saved_player, player2) == 0)) {
-            char *friend_name = strtok(friend_list, ",");
-            while (friend_name) {
-                if ((strcmp(saved_player, player1) == 0 && strcmp(friend_name, player2) == 0) ||
-                    (strcmp(saved_player, player2) == 0 && strcmp(friend_name, player1) == 0)) {
-                    fclose(file);
-                    return 1; // They are friends
-                }
-                friend_name = strtok(NULL, ",");
-            }
-        }
-    }
-
-    fclose(file);
-    return 0; // Not friends
-}
-
-void send_friend_request(const char *sender, const char *receiver) {
-    FILE *file = fopen("Database/friend_requests.txt", "a+");
-    if (!file) {
-        perror("Failed to open friend_requests.txt");
+    FILE *file = fopen(game_room->game_file, "a");
+    if (file == NULL) {
+        perror("Failed to open game file for appending");
         return;
     }
 
-    char line[64];
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_sender = strtok(line, "|");
-        char *saved_receiver = strtok(NULL, "\n");
-
-        if (saved_sender && saved_receiver &&
-            strcmp(saved_sender, sender) == 0 &&
-            strcmp(saved_receiver, receiver) == 0) {
-            fclose(file);
-            return; // Request already exists
-        }
-    }
-
-    // Append the new request
-    fprintf(file, "%s|%s\n", sender, receiver);
-    fclose(file);
-}
-
-int friend_request_exists(const char *sender, const char *receiver) {
-    FILE *file = fopen("Database/friend_requests.txt", "r");
-    if (!file) {
-        return 0; // Assume no request exists if file doesn't exist
-    }
-
-    char line[64];
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_sender = strtok(line, "|");
-        char *saved_receiver = strtok(NULL, "\n");
-
-        if (saved_sender && saved_receiver &&
-            strcmp(saved_sender, sender) == 0 &&
-            strcmp(saved_receiver, receiver) == 0) {
-            fclose(file);
-            return 1; // Request exists
-        }
+    int seeds = 0;
+    for (int i = 0; i < CASES; i++) {
+        seeds += board->pits[i];
     }
-
+    int mine = board->score[joueur] + (seeds + rest) / 2;
+    int theirs = board->score[1 - joueur] + (seeds - rest) / 2;
+    fprintf(file, "Endgame database: with perfect play, %s ends with %d seeds and %s with %d.\n",
+            player_name(game_room, joueur), mine, player_name(game_room, 1 - joueur), theirs);
     fclose(file);
-    return 0; // Request does not exist
 }
 
-int reciprocal_request_exists(const char *sender, const char *receiver) {
-    FILE *file = fopen("Database/friend_requests.txt", "r");
-    if (!file) {
-        return 0; // No reciprocal request if file doesn't exist
-    }
-
-    char line[64];
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_sender = strtok(line, "|");
-        char *saved_receiver = strtok(NULL, "\n");
-
-        if (saved_sender && saved_receiver &&
-            strcmp(saved_sender, receiver) == 0 &&
-            strcmp(saved_receiver, sender) == 0) {
-            fclose(file);
-            return 1; // Reciprocal request exists
-        }
+void finalize_game_file(GameRoom *game_room, const char *result) {
+    FILE *file = fopen(game_room->game_file, "a");
+    if (file == NULL) {
+        perror("Failed to open game file for finalizing");
+        return;
     }
 
+    fprintf(file, "Game Result: %s\n", result);
     fclose(file);
-    return 0; // No reciprocal request
 }
 
-int count_pending_requests(const char *player) {
-    FILE *file = fopen("Database/friend_requests.txt", "r");
-    if (!file) {
-        return 0; // No requests if file doesn't exist
-    }
-
-    char line[64];
-    int count = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        char *receiver = strtok(NULL, "\n");
-        if (receiver && strcmp(receiver, player) == 0) {
-            count++;
-        }
-    }
+//friend system
 
-    fclose(file);
-    return count;
+int are_friends(const char *player1, const char *player2) {
+    return friends_are(player1, player2);
 }
 
 static void handle_send_friend_request(int client_index) {
     const char *prompt = "Enter the name of the player you want to send a friend request to:\n";
     write_client(clients[client_index].sock, prompt);
+    clients[client_index].state = STATE_SEND_FRIEND_REQUEST;
+}
 
-    char buffer[32];
-    int n = read_client(clients[client_index].sock, buffer);
-    if (n > 0) {
-        buffer[n] = '\0';
-        buffer[strcspn(buffer, "\n")] = '\0'; // Remove newline
-
+static void complete_send_friend_request(int client_index, const char *buffer) {
+    if (buffer[0] != '\0') {
         // Prevent sending request to oneself
         if (strcmp(clients[client_index].name, buffer) == 0) {
             write_client(clients[client_index].sock, "You cannot send a friend request to yourself.\n");
@@ -551,65 +636,37 @@ static void handle_send_friend_request(int client_index) {
             return;
         }
 
-        // Check if already friends
-        if (are_friends(clients[client_index].name, buffer)) {
-            write_client(clients[client_index].sock, "You are already friends with this player.\n");
-            return;
-        }
-
-        // Prevent duplicate requests
-        if (friend_request_exists(clients[client_index].name, buffer)) {
-            write_client(clients[client_index].sock, "You have already sent a friend request to this player.\n");
-            return;
-        }
-
-        // Prevent reciprocal requests
-        if (reciprocal_request_exists(clients[client_index].name, buffer)) {
-            write_client(clients[client_index].sock, "This player has already sent you a friend request. Check your pending requests.\n");
-            return;
-        }
-
-        // Enforce request cap
-        if (count_pending_requests(buffer) >= 15) {
-            write_client(clients[client_index].sock, "This player has reached the maximum number of pending friend requests.\n");
-            return;
+        // Friendship, duplicate, reciprocal and cap checks go with the insertion
+        const char *reply = "Friend request sent.\n";
+        switch (friends_request(clients[client_index].name, buffer, MAX_PENDING_REQUESTS)) {
+        case FRIEND_REQUEST_SENT:
+            break;
+        case FRIEND_REQUEST_ALREADY_FRIENDS:
+            reply = "You are already friends with this player.\n";
+            break;
+        case FRIEND_REQUEST_DUPLICATE:
+            reply = "You have already sent a friend request to this player.\n";
+            break;
+        case FRIEND_REQUEST_RECIPROCAL:
+            reply = "This player has already sent you a friend request. Check your pending requests.\n";
+            break;
+        case FRIEND_REQUEST_FULL:
+            reply = "This player has reached the maximum number of pending friend requests.\n";
+            break;
         }
-
-        // Send friend request
-        send_friend_request(clients[client_index].name, buffer);
-        write_client(clients[client_index].sock, "Friend request sent.\n");
+        write_client(clients[client_index].sock, reply);
     } else {
         write_client(clients[client_index].sock, "Failed to send friend request. Try again.\n");
     }
 }
 
 int fetch_pending_requests(const char *receiver, char requests[][32], int *num_requests) {
-    FILE *file = fopen("Database/friend_requests.txt", "r");
-    if (!file) {
-        perror("Failed to open friend_requests.txt");
-        *num_requests = 0;
-        return 0;
-    }
-
-    char line[64];
-    *num_requests = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        char *sender = strtok(line, "|");
-        char *saved_receiver = strtok(NULL, "\n");
-
-        if (sender && saved_receiver && strcmp(saved_receiver, receiver) == 0) {
-            strncpy(requests[*num_requests], sender, 32);
-            (*num_requests)++;
-        }
-    }
-
-    fclose(file);
-    return 1; // Success
+    *num_requests = friends_request_list(receiver, requests, MAX_PENDING_REQUESTS);
+    return 1;
 }
 
 static void handle_view_pending_requests(int client_index) {
-    char requests[15][32]; // Max 15 pending requests
+    char requests[MAX_PENDING_REQUESTS][PLAYER_NAME_SIZE];
     int num_requests = 0;
 
     if (!fetch_pending_requests(clients[client_index].name, requests, &num_requests)) {
@@ -631,169 +688,74 @@ static void handle_view_pending_requests(int client_index) {
 }
 
 void accept_friend_request(const char *player, const char *friend_name) {
-    FILE *file = fopen("Database/friends.txt", "r");
-    FILE *temp = fopen("Database/friends_tmp.txt", "w");
-    if (!file || !temp) {
-        perror("Failed to open friends.txt or temporary file");
-        if (file) fclose(file);
-        if (temp) fclose(temp);
-        return;
-    }
-
-    char line[512];
-    int player_found = 0;
-    int friend_found = 0;
-
-    // Process the file and add the new friendship
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_player = strtok(line, "|");
-        char *friends = strtok(NULL, "\n");
-
-        if (saved_player) {
-            if (strcmp(saved_player, player) == 0) {
-                player_found = 1;
-                fprintf(temp, "%s|%s%s%s\n", saved_player, friends ? friends : "",
-                        friends ? "," : "", friend_name);
-            } else if (strcmp(saved_player, friend_name) == 0) {
-                friend_found = 1;
-                fprintf(temp, "%s|%s%s%s\n", saved_player, friends ? friends : "",
-                        friends ? "," : "", player);
-            } else {
-                fprintf(temp, "%s|%s\n", saved_player, friends ? friends : "");
-            }
-        }
-    }
-
-    // If player or friend doesn't exist in the file, add them
-    if (!player_found) {
-        fprintf(temp, "%s|%s\n", player, friend_name);
-    }
-    if (!friend_found) {
-        fprintf(temp, "%s|%s\n", friend_name, player);
-    }
-
-    fclose(file);
-    fclose(temp);
-    remove("Database/friends.txt");
-    rename("Database/friends_tmp.txt", "Database/friends.txt");
+    friends_add(player, friend_name);
 }
 
 void remove_friend_request(const char *sender, const char *receiver) {
-    FILE *file = fopen("Database/friend_requests.txt", "r");
-    if (!file) {
-        perror("Failed to open friend_requests.txt");
-        return;
-    }
-
-    FILE *temp = fopen("Database/friend_requests_tmp.txt", "w");
-    if (!temp) {
-        perror("Failed to open temporary file for friend_requests.txt");
-        fclose(file);
-        return;
-    }
-
-    char line[64];
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_sender = strtok(line, "|");
-        char *saved_receiver = strtok(NULL, "\n");
-
-        if (saved_sender && saved_receiver &&
-            !(strcmp(saved_sender, sender) == 0 && strcmp(saved_receiver, receiver) == 0)) {
-            fprintf(temp, "%s|%s\n", saved_sender, saved_receiver);
-        }
-    }
-
-    fclose(file);
-    fclose(temp);
-    remove("Database/friend_requests.txt");
-    rename("Database/friend_requests_tmp.txt", "Database/friend_requests.txt");
+    friends_drop_request(sender, receiver);
 }
 
-static void handle_accept_friend_request(int client_index) {
-    char requests[15][32]; // Max 15 pending requests
-    int num_requests = 0;
+static int handle_accept_friend_request(int client_index) {
+    Client *client = &clients[client_index];
 
-    // Fetch pending requests
-    if (!fetch_pending_requests(clients[client_index].name, requests, &num_requests)) {
-        write_client(clients[client_index].sock, "No pending friend requests.\n");
-        return;
+    // Fetch pending requests; the list is kept until the answer comes in
+    if (!fetch_pending_requests(client->name, client->pending_requests, &client->num_pending_requests)) {
+        write_client(client->sock, "No pending friend requests.\n");
+        return 0;
     }
 
-    if (num_requests == 0) {
-        write_client(clients[client_index].sock, "No pending friend requests.\n");
-        return;
+    if (client->num_pending_requests == 0) {
+        write_client(client->sock, "No pending friend requests.\n");
+        return 0;
     }
     char buffer[512] = "Pending friend requests:\n";
-    for (int i = 0; i < num_requests; i++) {
+    for (int i = 0; i < client->num_pending_requests; i++) {
         char temp[64];
-        snprintf(temp, sizeof(temp), "%d. %s\n", i + 1, requests[i]);
+        snprintf(temp, sizeof(temp), "%d. %s\n", i + 1, client->pending_requests[i]);
         strncat(buffer, temp, sizeof(buffer) - strlen(buffer) - 1);
     }
 
     strncat(buffer, "Enter the number of the request to accept or decline (e.g., '1 accept' or '2 decline'):\n", sizeof(buffer) - strlen(buffer) - 1);
-    write_client(clients[client_index].sock, buffer);
+    write_client(client->sock, buffer);
+    client->state = STATE_ANSWER_FRIEND_REQUEST;
+    return 1;
+}
 
-    char response[64];
-    int n = read_client(clients[client_index].sock, response);
-    if (n > 0) {
-        response[n] = '\0';
-        response[strcspn(response, "\n")] = '\0'; // Remove newline
+static void complete_accept_friend_request(int client_index, const char *response) {
+    Client *client = &clients[client_index];
 
+    if (response[0] != '\0') {
         int choice;
         char action[10];
-        if (sscanf(response, "%d %s", &choice, action) == 2 && choice > 0 && choice <= num_requests) {
-            const char *selected_request = requests[choice - 1];
+        if (sscanf(response, "%d %9s", &choice, action) == 2 && choice > 0 && choice <= client->num_pending_requests) {
+            const char *selected_request = client->pending_requests[choice - 1];
 
             if (strcmp(action, "accept") == 0) {
-                accept_friend_request(clients[client_index].name, selected_request);
-                remove_friend_request(selected_request, clients[client_index].name);
-                write_client(clients[client_index].sock, "Friend request accepted.\n");
+                accept_friend_request(client->name, selected_request);
+                remove_friend_request(selected_request, client->name);
+                write_client(client->sock, "Friend request accepted.\n");
             } else if (strcmp(action, "decline") == 0) {
-                remove_friend_request(selected_request, clients[client_index].name);
-                write_client(clients[client_index].sock, "Friend request declined.\n");
+                remove_friend_request(selected_request, client->name);
+                write_client(client->sock, "Friend request declined.\n");
             } else {
-                write_client(clients[client_index].sock, "Invalid action. Use 'accept' or 'decline'.\n");
+                write_client(client->sock, "Invalid action. Use 'accept' or 'decline'.\n");
             }
         } else {
-            write_client(clients[client_index].sock, "Invalid input. Try again.\n");
+            write_client(client->sock, "Invalid input. Try again.\n");
         }
     } else {
-        write_client(clients[client_index].sock, "Failed to read input. Try again.\n");
+        write_client(client->sock, "Failed to read input. Try again.\n");
     }
+    client->num_pending_requests = 0;
 }
 
 int fetch_friends(const char *player, char friends[][32], int *num_friends) {
-    FILE *file = fopen("Database/friends.txt", "r");
-    if (!file) {
-        perror("Failed to open friends.txt");
-        *num_friends = 0;
-        return 0; // No friends if file doesn't exist
-    }
-
-    char line[512];
-    *num_friends = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-        char *saved_player = strtok(line, "|");
-        char *friend_list = strtok(NULL, "\n");
-
-        if (saved_player && strcmp(saved_player, player) == 0 && friend_list) {
-            char *friend_name = strtok(friend_list, ",");
-            while (friend_name) {
-                strncpy(friends[*num_friends], friend_name, 32);
-                (*num_friends)++;
-                friend_name = strtok(NULL, ",");
-            }
-            break; // We found the player; no need to continue
-        }
-    }
-
-    fclose(file);
-    return 1; // Success
+    *num_friends = friends_list(player, friends, MAX_LISTED_FRIENDS);
+    return 1;
 }
 
 static void handle_view_friends_list(int client_index) {
-    char friends[50][32]; // Max 50 friends
+    char friends[MAX_LISTED_FRIENDS][PLAYER_NAME_SIZE];
     int num_friends = 0;
 
     // Fetch friends
@@ -809,7 +771,7 @@ static void handle_view_friends_list(int client_index) {
     }
 
     // Display friends list
-    char buffer[512] = "Your friends:\n";
+    char buffer[MAX_LISTED_FRIENDS * PLAYER_NAME_SIZE + 32] = "Your friends:\n";
     for (int i = 0; i < num_friends; i++) {
         strncat(buffer, friends[i], sizeof(buffer) - strlen(buffer) - 1);
         strncat(buffer, "\n", sizeof(buffer) - strlen(buffer) - 1);
@@ -818,106 +780,760 @@ static void handle_view_friends_list(int client_index) {
     write_client(clients[client_index].sock, buffer);
 }
 
-static void handle_new_connection(SOCKET sock, int *actual) {
-    SOCKADDR_IN csin = {0};
-    socklen_t sinsize = sizeof(csin);
-    int csock = accept(sock, (SOCKADDR *)&csin, &sinsize);
-    if (csock == SOCKET_ERROR) {
-        perror("accept()");
-        return;
-    }
-
-    char buffer[BUF_SIZE];
-    if (read_client(csock, buffer) <= 0) {
-        return;
+// Takes a slot from the free list, growing the slab when it is empty
+static int alloc_client_slot(SOCKET csock) {
+    if (free_slot < 0) {
+        int new_capacity = clients_capacity ? clients_capacity * 2 : 64;
+        Client *grown = realloc(clients, new_capacity * sizeof(Client));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(grown + clients_capacity, 0, (new_capacity - clients_capacity) * sizeof(Client));
+        for (int i = new_capacity - 1; i >= clients_capacity; i--) {
+            grown[i].generation = 1;
+            grown[i].next_free = free_slot;
+            free_slot = i;
+        }
+        clients = grown;
+        clients_capacity = new_capacity;
     }
 
-    Client c = {csock};
-    strncpy(c.name, buffer, sizeof(c.name) - 1);
-    c.in_room = 0;
-    c.room_id = -1;
-    c.waiting_for_response = 0;
-    clients[*actual] = c;
-    (*actual)++;
-    add_player_to_registry(c.name);
-    send_welcome_message(&c);
+    if (csock >= fd_capacity) {
+        int new_capacity = fd_capacity ? fd_capacity : 64;
+        while (new_capacity <= csock) {
+            new_capacity *= 2;
+        }
+        int *grown = realloc(client_of_fd, new_capacity * sizeof(int));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        for (int i = fd_capacity; i < new_capacity; i++) {
+            grown[i] = -1;
+        }
+        client_of_fd = grown;
+        fd_capacity = new_capacity;
+    }
+
+    int index = free_slot;
+    uint32_t generation = clients[index].generation;
+    free_slot = clients[index].next_free;
+    memset(&clients[index], 0, sizeof(Client));
+    clients[index].generation = generation;
+    clients[index].sock = csock;
+    clients[index].live = 1;
+    clients[index].next_free = -1;
+    return index;
 }
 
-static void handle_disconnection(int client_index, int *actual) {
-    close(clients[client_index].sock);
-    remove_client(clients, client_index, actual);
-    send_player_list(clients, *actual, client_index);
+// Returns the slot to the free list; handles to it go stale
+static void release_client_slot(int index) {
+    clients[index].live = 0;
+    if (++clients[index].generation == 0) {
+        clients[index].generation = 1;
+    }
+    clients[index].next_free = free_slot;
+    free_slot = index;
 }
 
-static void add_observer(int room_id, int observer_socket,int client_index) {
-    GameRoom *game_room = &game_rooms[room_id];
+static ClientHandle handle_of(int client_index) {
+    return ((ClientHandle)clients[client_index].generation << 32) | (uint32_t)client_index;
+}
 
-    if (game_room->observer_count >= MAX_CLIENTS) {
-        write_client(observer_socket, "The game room is full. Cannot observe.\n");
-        return;
+// Resolves a handle to its slot, or -1 if that client has left
+static int client_from_handle(ClientHandle handle) {
+    uint32_t index = (uint32_t)handle;
+    if (index >= (uint32_t)clients_capacity || !clients[index].live ||
+        clients[index].generation != (uint32_t)(handle >> 32)) {
+        return -1;
     }
+    return index;
+}
 
-    game_room->observers[game_room->observer_count++] = observer_socket;
-    clients[client_index].observing = 1;
-    clients[client_index].room_id = room_id;
-    char buffer[BUF_SIZE];
-    snprintf(buffer, BUF_SIZE, "You are now observing Game Room %d.\n", room_id);
-    write_client(observer_socket, buffer);
-
-    // Show the current board state
-    char *board_state = afficher_plateau(&game_room->board);
-    write_client(observer_socket, board_state);
-    free(board_state);
+static int find_client(SOCKET sock) {
+    if (sock < 0 || sock >= fd_capacity) {
+        return -1;
+    }
+    return client_of_fd[sock];
 }
 
-static void notify_observers(int room_id, const char *message) {
-    GameRoom *game_room = &game_rooms[room_id];
+// Name of a room's player, who may have left since the game started
+static const char *player_name(GameRoom *game_room, int player) {
+    if (player == game_room->bot_seat) {
+        return BOT_NAME;
+    }
+    int i = client_from_handle(game_room->players[player]);
+    return i >= 0 ? clients[i].name : "(disconnected)";
+}
 
-    for (int i = 0; i < game_room->observer_count; i++) {
-        write_client(game_room->observers[i], message);
+// Players who left are skipped; their socket may already belong to someone else
+static void write_player_event(GameRoom *game_room, int player, const char *text, const char *frame, size_t len) {
+    int i = client_from_handle(game_room->players[player]);
+    if (i >= 0) {
+        write_either(clients[i].sock, text, frame, len);
     }
 }
 
-static void list_ongoing_games(int client_index) {
-    char buffer[BUF_SIZE] = "Currently ongoing games:\n";
+static void watch_client(int client_index) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.u64 = handle_of(client_index);
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[client_index].sock, &ev) == -1) {
+        perror("epoll_ctl()");
+    }
+}
 
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (game_rooms[i].player_sockets[0] > 0 && game_rooms[i].player_sockets[1] > 0) {
-            char game_entry[128];
-            snprintf(game_entry, sizeof(game_entry), "Room ID: %d | Players: %s vs %s | Observers: %d\n",
-                     i,
-                     clients[game_rooms[i].player_index[0]].name,
-                     clients[game_rooms[i].player_index[1]].name,
-                     game_rooms[i].observer_count);
-            strncat(buffer, game_entry, sizeof(buffer) - strlen(buffer) - 1);
+// Accepts every connection the backlog holds. Nothing is read here: the client
+// logs in through the event loop like any other command, within LOGIN_TIMEOUT_MS.
+static void handle_new_connection(SOCKET sock, int *actual) {
+    for (;;) {
+        SOCKADDR_IN csin = {0};
+        socklen_t sinsize = sizeof(csin);
+        int csock = accept4(sock, (SOCKADDR *)&csin, &sinsize, SOCK_NONBLOCK);
+        if (csock == SOCKET_ERROR) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept()");
+            }
+            return;
         }
-    }
 
-    if (strlen(buffer) == strlen("Currently ongoing games:\n")) {
-        strncat(buffer, "No ongoing games.\n", sizeof(buffer) - strlen(buffer) - 1);
+        int index = alloc_client_slot(csock);
+        Client *c = &clients[index];
+        c->state = STATE_LOGIN;
+        c->room_id = -1;
+        c->duel_handle = NO_CLIENT;
+        client_of_fd[csock] = index;
+        (*actual)++;
+        watch_client(index);
+        timer_add(&timers, timer_now() + LOGIN_TIMEOUT_MS, handle_of(index));
     }
-
-    write_client(clients[client_index].sock, buffer);
 }
 
-static void observe_game(int client_index, int room_id) {
-    if (room_id < 0 || room_id >= MAX_CLIENTS) {
-        write_client(clients[client_index].sock, "Invalid room ID.\n");
+// The first command is the name, unless the client first asks for the binary protocol
+static void complete_login(int client_index, const char *buffer) {
+    Client *c = &clients[client_index];
+    if (!c->binary && strcmp(buffer, PROTO_HELLO_LINE) == 0) {
+        // Everything after the hello line comes in frames
+        c->binary = 1;
         return;
     }
 
-    GameRoom *game_room = &game_rooms[room_id];
-
-    if (game_room->player_sockets[0] == 0 || game_room->player_sockets[1] == 0) {
-        write_client(clients[client_index].sock, "No active game in this room.\n");
-        return;
+    strncpy(c->name, buffer, sizeof(c->name) - 1);
+    c->state = STATE_MENU;
+    lobby_add(c->sock, c->name, reactor_id, handle_of(client_index));
+    add_player_to_registry(c->name);
+    if (c->binary) {
+        char frame[PROTO_HEADER + 1];
+        queue_output(client_index, frame, proto_hello(frame));
     }
-      // Check if the room is "friends-only"
+    send_welcome_message(c);
+}
+
+// Drops the connections whose login deadline has passed
+static void expire_timers(int *actual) {
+    uint64_t now = timer_now();
+    uint64_t token;
+
+    while (timer_pop_expired(&timers, now, &token)) {
+        // Clients that logged in or left in the meantime are no longer concerned
+        int i = client_from_handle(token);
+        if (i >= 0 && clients[i].state == STATE_LOGIN) {
+            fprintf(stderr, "Dropping connection %d: no login within %d ms\n", clients[i].sock, LOGIN_TIMEOUT_MS);
+            handle_disconnection(i, actual);
+        }
+    }
+}
+
+static void handle_disconnection(int client_index, int *actual) {
+    // Nothing more is sent to a leaving client
+    clients[client_index].closing = 1;
+    if (clients[client_index].in_room) {
+        forfeit_game(client_index);
+    } else if (clients[client_index].observing) {
+        remove_observer(client_index);
+    }
+    remove_client(clients, client_index, actual);
+}
+
+// Drops a client from this reactor's tables without closing its socket
+static void detach_client(int to_remove, int *actual) {
+    client_of_fd[clients[to_remove].sock] = -1;
+    release_client_slot(to_remove);
+    (*actual)--;
+}
+
+// Hands a lobby client over to another reactor, which runs action once it owns it
+static void migrate_client(int client_index, int *actual, int target, AdoptAction action, int arg) {
+    Message *msg = new_message(MSG_ADOPT, client_index);
+    msg->action = action;
+    msg->arg = arg;
+    msg->client = malloc(sizeof(Client));
+    if (!msg->client) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    *msg->client = clients[client_index];
+    msg->client->pending = 0;
+    msg->client->want_write = 0;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, clients[client_index].sock, NULL) == -1) {
+        perror("epoll_ctl()");
+    }
+    // Unreachable until the target reactor has given it a handle
+    lobby_move(clients[client_index].sock, target, NO_CLIENT);
+    detach_client(client_index, actual);
+    reactor_post(target, &msg->link);
+}
+
+static int adopt_client(Message *msg, int *actual) {
+    SOCKET csock = msg->client->sock;
+    int index = alloc_client_slot(csock);
+    uint32_t generation = clients[index].generation;
+
+    clients[index] = *msg->client;
+    clients[index].generation = generation;
+    clients[index].live = 1;
+    clients[index].next_free = -1;
+    client_of_fd[csock] = index;
+    (*actual)++;
+
+    watch_client(index);
+    lobby_move(csock, reactor_id, handle_of(index));
+    // Output queued before the move still has to go out
+    mark_pending(index);
+    return index;
+}
+
+static void handle_duel_answer(Message *msg, int *actual) {
+    int i = client_from_handle(msg->to_handle);
+    int still_waiting = i >= 0 && !clients[i].in_room && clients[i].duel_handle == msg->from_handle;
+
+    if (msg->arg < 0) {
+        if (i < 0) {
+            return;
+        }
+        // Notify the requester about the refusal
+        char refuse_msg[BUF_SIZE];
+        snprintf(refuse_msg, sizeof(refuse_msg), "Your game request was refused by %s.\n", msg->from_name);
+        write_client(clients[i].sock, refuse_msg);
+
+        // Reset the room state
+        clients[i].room_id = -1;
+        clients[i].in_room = 0;
+        clients[i].waiting_for_response = 0;
+        clients[i].duel_handle = NO_CLIENT;
+        return;
+    }
+
+    if (!still_waiting) {
+        char buffer[BUF_SIZE];
+        snprintf(buffer, sizeof(buffer), "%s is no longer available for a duel.\n", msg->to_name);
+        post_text(msg->from_reactor, msg->from_handle, msg->from_name, buffer);
+        return;
+    }
+
+    if (msg->arg == reactor_id) {
+        int j = client_from_handle(msg->from_handle);
+        if (j >= 0 && !clients[j].in_room) {
+            start_private_chat(j, i);
+        }
+        return;
+    }
+
+    // The acceptor's reactor hosts the room, so the requester moves there
+    migrate_client(i, actual, msg->arg, ADOPT_DUEL, 0);
+}
+
+static void handle_adoption(Message *msg, int *actual) {
+    int i = adopt_client(msg, actual);
+    ClientHandle handle = handle_of(i);
+
+    if (msg->action == ADOPT_DUEL) {
+        // The acceptor still knows the requester by the handle it had on its old reactor
+        int j = client_from_handle(clients[i].duel_handle);
+        if (j >= 0 && !clients[j].in_room && clients[j].duel_handle == msg->from_handle) {
+            start_private_chat(j, i);
+        } else {
+            char buffer[BUF_SIZE];
+            snprintf(buffer, sizeof(buffer), "%s is no longer available for a duel.\n", clients[i].duel_name);
+            write_client(clients[i].sock, buffer);
+            clients[i].waiting_for_response = 0;
+            clients[i].duel_handle = NO_CLIENT;
+            send_welcome_message(&clients[i]);
+        }
+    } else if (msg->action == ADOPT_OBSERVE) {
+        observe_game(i, msg->arg);
+    }
+
+    // Commands that arrived while the client was in flight
+    dispatch_commands(handle, actual);
+}
+
+static void handle_mailbox(int *actual) {
+    Envelope *envelope = reactor_take_all(reactor_id);
+
+    while (envelope) {
+        Message *msg = (Message *)envelope;
+        envelope = envelope->next;
+        int i;
+
+        switch (msg->type) {
+        case MSG_TEXT:
+            if ((i = client_from_handle(msg->to_handle)) >= 0) {
+                write_client(clients[i].sock, msg->text);
+            }
+            break;
+        case MSG_DUEL_REQUEST:
+            i = client_from_handle(msg->to_handle);
+            if (i < 0 || clients[i].in_room) {
+                char buffer[BUF_SIZE];
+                snprintf(buffer, BUF_SIZE, "Player %s is not available for a duel.\n", msg->to_name);
+                post_text(msg->from_reactor, msg->from_handle, msg->from_name, buffer);
+            } else {
+                char buffer[BUF_SIZE];
+                snprintf(buffer, BUF_SIZE, "%s has challenged you to a duel! Type 'accept' to join, or 'refuse' to decline and go back", msg->from_name);
+                write_client(clients[i].sock, buffer);
+                clients[i].duel_reactor = msg->from_reactor;
+                clients[i].duel_handle = msg->from_handle;
+                strncpy(clients[i].duel_name, msg->from_name, sizeof(clients[i].duel_name) - 1);
+            }
+            break;
+        case MSG_DUEL_ANSWER:
+            handle_duel_answer(msg, actual);
+            break;
+        case MSG_ADOPT:
+            handle_adoption(msg, actual);
+            break;
+        case MSG_LIST_GAMES: {
+            Message *reply = new_message(MSG_GAMES_PART, -1);
+            reply->to_handle = msg->from_handle;
+            describe_rooms(reply->text, sizeof(reply->text));
+            reactor_post(msg->from_reactor, &reply->link);
+            break;
+        }
+        case MSG_GAMES_PART:
+            if ((i = client_from_handle(msg->to_handle)) >= 0) {
+                add_games_part(i, msg->text);
+            }
+            break;
+        case MSG_BOT_MOVE: {
+            // The human may have left while the bot was thinking
+            GameRoom *game_room = room_from_id(msg->arg);
+            if (game_room && game_room->current_turn == game_room->bot_seat) {
+                play_move(msg->arg, game_room->bot_seat, msg->move);
+            }
+            break;
+        }
+        }
+        free(msg->client);
+        free(msg);
+    }
+}
+
+// Takes a room from the free list, growing the pool when it is empty.
+// Returns the room ID, or -1 once every slot an ID can address is in use.
+static int alloc_room(void) {
+    if (free_room < 0) {
+        if (rooms_capacity == 1 << ROOM_INDEX_BITS) {
+            return -1;
+        }
+        int new_capacity = rooms_capacity ? rooms_capacity * 2 : 16;
+        GameRoom *grown = realloc(game_rooms, new_capacity * sizeof(GameRoom));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        memset(grown + rooms_capacity, 0, (new_capacity - rooms_capacity) * sizeof(GameRoom));
+        for (int i = new_capacity - 1; i >= rooms_capacity; i--) {
+            grown[i].next_free = free_room;
+            free_room = i;
+        }
+        game_rooms = grown;
+        rooms_capacity = new_capacity;
+    }
+
+    int index = free_room;
+    GameRoom *game_room = &game_rooms[index];
+    uint32_t generation = game_room->generation;
+    ClientHandle *observers = game_room->observers;
+    int observer_capacity = game_room->observer_capacity;
+    free_room = game_room->next_free;
+    memset(game_room, 0, sizeof(GameRoom));
+    game_room->generation = generation;
+    game_room->observers = observers;
+    game_room->observer_capacity = observer_capacity;
+    game_room->bot_seat = -1;
+    game_room->active = 1;
+    game_room->next_free = -1;
+
+    // Newest rooms go first in listings
+    game_room->prev_active = -1;
+    game_room->next_active = active_rooms;
+    if (active_rooms >= 0) {
+        game_rooms[active_rooms].prev_active = index;
+    }
+    active_rooms = index;
+
+    // Generations wrap early so that IDs stay positive ints
+    return (int)((generation & ROOM_GENERATION_MASK) << ROOM_INDEX_BITS) | index;
+}
+
+// Returns the room's slot to the free list; its ID goes stale
+static void release_room(int room_id) {
+    int index = room_id & ((1 << ROOM_INDEX_BITS) - 1);
+    GameRoom *game_room = &game_rooms[index];
+
+    if (game_room->prev_active >= 0) {
+        game_rooms[game_room->prev_active].next_active = game_room->next_active;
+    } else {
+        active_rooms = game_room->next_active;
+    }
+    if (game_room->next_active >= 0) {
+        game_rooms[game_room->next_active].prev_active = game_room->prev_active;
+    }
+
+    game_room->active = 0;
+    game_room->generation++;
+    game_room->next_free = free_room;
+    free_room = index;
+}
+
+// Resolves a room ID to its room, or NULL if that game has ended
+static GameRoom *room_from_id(int room_id) {
+    if (room_id < 0) {
+        return NULL;
+    }
+    int index = room_id & ((1 << ROOM_INDEX_BITS) - 1);
+    uint32_t generation = (uint32_t)room_id >> ROOM_INDEX_BITS;
+    if (index >= rooms_capacity || !game_rooms[index].active ||
+        (game_rooms[index].generation & ROOM_GENERATION_MASK) != generation) {
+        return NULL;
+    }
+    return &game_rooms[index];
+}
+
+// Ends the game: players and observers go back to the menu and the room is released
+static void close_room(int room_id) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    for (int k = 0; k < 2; k++) {
+        int p = client_from_handle(game_room->players[k]);
+        if (p >= 0) {
+            clients[p].in_room = 0;
+            clients[p].room_id = -1;
+            lobby_set_in_room(clients[p].sock, 0);
+            send_welcome_message(&clients[p]);
+        }
+    }
+    for (int k = 0; k < game_room->observer_count; k++) {
+        int o = client_from_handle(game_room->observers[k]);
+        if (o >= 0) {
+            clients[o].observing = 0;
+            clients[o].room_id = -1;
+            send_welcome_message(&clients[o]);
+        }
+    }
+    game_room->observer_count = 0;
+
+    release_room(room_id);
+}
+
+// The client leaves its game, which the other player wins
+static void forfeit_game(int client_index) {
+    int room_id = clients[client_index].room_id;
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    // Either player may leave, not only the one whose turn it is
+    int opponent = game_room->players[0] == handle_of(client_index) ? 1 : 0;
+    char end_msg[BUF_SIZE];
+    snprintf(end_msg, BUF_SIZE, "Player %s disconnected. You won!\n", clients[client_index].name);
+    if (game_room->bot_seat < 0) {
+        record_game_result(player_name(game_room, opponent), clients[client_index].name);
+    }
+    char frame[PROTO_HEADER + 2];
+    size_t frame_len = proto_result(frame, opponent, RESULT_FORFEIT);
+    notify_observers_event(room_id, end_msg, frame, frame_len);
+    finalize_game_file(game_room, end_msg);
+
+    // Notify the opponent
+    write_player_event(game_room, opponent, end_msg, frame, frame_len);
+    write_player_event(game_room, 1 - opponent, NULL, frame, frame_len);
+    close_room(room_id);
+}
+
+static void add_observer(int room_id, int client_index) {
+    GameRoom *game_room = room_from_id(room_id);
+
+    if (game_room->observer_count == game_room->observer_capacity) {
+        int new_capacity = game_room->observer_capacity ? game_room->observer_capacity * 2 : 8;
+        ClientHandle *grown = realloc(game_room->observers, new_capacity * sizeof(ClientHandle));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        game_room->observers = grown;
+        game_room->observer_capacity = new_capacity;
+    }
+
+    // The client remembers its entry so that leaving is a swap with the last one
+    clients[client_index].observer_slot = game_room->observer_count;
+    game_room->observers[game_room->observer_count++] = handle_of(client_index);
+    clients[client_index].observing = 1;
+    clients[client_index].room_id = room_id;
+    char buffer[BUF_SIZE];
+    snprintf(buffer, BUF_SIZE, "You are now observing Game Room %lld.\n", global_room_id(room_id));
+    write_client(clients[client_index].sock, buffer);
+
+    // Show the current board state
+    if (clients[client_index].binary) {
+        char frame[PROTO_BOARD_SIZE + PROTO_HEADER + 2];
+        size_t frame_len = proto_board(frame, &game_room->board);
+        frame_len += proto_turn(frame + frame_len, game_room->current_turn, PROTO_NO_SEAT);
+        queue_output(client_index, frame, frame_len);
+    } else {
+        SharedBuf *board_state = board_text(&game_room->board);
+        queue_shared(client_index, board_state);
+        sharedbuf_release(board_state);
+    }
+}
+
+// Takes the client off its room's observers, if the game is still on
+static void remove_observer(int client_index) {
+    GameRoom *game_room = room_from_id(clients[client_index].room_id);
+    int slot = clients[client_index].observer_slot;
+    if (game_room && slot < game_room->observer_count &&
+        game_room->observers[slot] == handle_of(client_index)) {
+        ClientHandle last = game_room->observers[--game_room->observer_count];
+        game_room->observers[slot] = last;
+        int moved = client_from_handle(last);
+        if (moved >= 0) {
+            clients[moved].observer_slot = slot;
+        }
+    }
+
+    clients[client_index].observing = 0;
+    clients[client_index].room_id = -1;
+}
+
+// One message for many recipients. Each wire form is built the first time a
+// recipient needs it and then shared by every output queue, never copied.
+typedef struct {
+    const char *text;   // For people, NULL to skip them
+    const char *frame;  // For binary clients
+    size_t frame_len;
+    int wrap_text;      // 1 if binary clients get text in a TEXT frame rather than frame
+    SharedBuf *text_buf;  // May be given up front, text is then only checked for NULL
+    SharedBuf *frame_buf;
+} Broadcast;
+
+static void broadcast_to(Broadcast *b, int client_index) {
+    SharedBuf **buf;
+    if (clients[client_index].binary) {
+        if (b->wrap_text ? !b->text : !b->frame) {
+            return;
+        }
+        buf = &b->frame_buf;
+        if (!*buf && b->wrap_text) {
+            size_t len = strlen(b->text);
+            *buf = sharedbuf_alloc(PROTO_HEADER + len);
+            proto_header((*buf)->data, OP_TEXT, len);
+            memcpy((*buf)->data + PROTO_HEADER, b->text, len);
+        } else if (!*buf) {
+            *buf = sharedbuf_alloc(b->frame_len);
+            memcpy((*buf)->data, b->frame, b->frame_len);
+        }
+    } else {
+        if (!b->text) {
+            return;
+        }
+        buf = &b->text_buf;
+        if (!*buf) {
+            size_t len = strlen(b->text);
+            *buf = sharedbuf_alloc(len);
+            memcpy((*buf)->data, b->text, len);
+        }
+    }
+    queue_shared(client_index, *buf);
+}
+
+// Sends b to the players and/or observers of the room, then drops the builder's references
+static void broadcast_room(GameRoom *game_room, Broadcast *b, int to_players, int to_observers) {
+    for (int i = 0; to_players && i < 2; i++) {
+        int p = client_from_handle(game_room->players[i]);
+        if (p >= 0) {
+            broadcast_to(b, p);
+        }
+    }
+    for (int i = 0; to_observers && i < game_room->observer_count; i++) {
+        int o = client_from_handle(game_room->observers[i]);
+        if (o >= 0) {
+            broadcast_to(b, o);
+        }
+    }
+    sharedbuf_release(b->text_buf);
+    sharedbuf_release(b->frame_buf);
+}
+
+// Observers get text if they are people and the frame if they speak the binary protocol
+static void notify_observers_event(int room_id, const char *text, const char *frame, size_t len) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    Broadcast b = {text, frame, len, 0, NULL, NULL};
+    broadcast_room(game_room, &b, 0, 1);
+}
+
+// A game event for everyone following the room
+static void send_room_event(int room_id, const char *text, const char *frame, size_t len) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    Broadcast b = {text, frame, len, 0, NULL, NULL};
+    broadcast_room(game_room, &b, 1, 1);
+}
+
+// Returns a reference to the room-style text of the board, rendered at most
+// once per position while it stays in this reactor's cache
+static SharedBuf *board_text(const Plateau *plateau) {
+    Board board;
+    board_from_plateau(&board, plateau);
+    RenderedBoard *slot = &render_cache[zobrist_key(&board, 0) & (RENDER_CACHE_SIZE - 1)];
+    if (!slot->text || memcmp(&slot->board, &board, sizeof(Board)) != 0) {
+        // Nobody else holds the old text: render over it instead of reallocating.
+        // Queues on other reactors (migrated clients) may still be dropping their
+        // references, hence the acquire load rather than a plain read.
+        if (!slot->text || !sharedbuf_exclusive(slot->text)) {
+            sharedbuf_release(slot->text);
+            slot->text = sharedbuf_alloc(PLATEAU_TEXTE_MAX);
+        }
+        slot->text->len = ecrire_plateau(slot->text->data, plateau);
+        slot->board = board;
+    }
+    return sharedbuf_retain(slot->text);
+}
+
+// Sends the room's board to everyone in it, frame to binary clients
+static void send_room_board(int room_id, const char *frame, size_t len) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    SharedBuf *text = board_text(&game_room->board);
+    Broadcast b = {text->data, frame, len, 0, text, NULL};
+    broadcast_room(game_room, &b, 1, 1);
+}
+
+// Tells the player to move with text; binary clients learn whose turn it is and their own seat
+static void announce_turn(int room_id, const char *text) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    char frame[PROTO_HEADER + 2];
+    for (int i = 0; i < 2; i++) {
+        size_t len = proto_turn(frame, game_room->current_turn, i);
+        write_player_event(game_room, i, i == game_room->current_turn ? text : NULL, frame, len);
+    }
+    size_t len = proto_turn(frame, game_room->current_turn, PROTO_NO_SEAT);
+    notify_observers_event(room_id, NULL, frame, len);
+}
+
+static void notify_observers(int room_id, const char *message) {
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
+    }
+
+    Broadcast b = {message, NULL, 0, 1, NULL, NULL};
+    broadcast_room(game_room, &b, 0, 1);
+}
+
+// Room IDs shown to users encode the owning reactor
+static long long global_room_id(int room_id) {
+    return (long long)room_id * reactor_count() + reactor_id;
+}
+
+// Appends this reactor's rooms to buffer
+static void describe_rooms(char *buffer, size_t size) {
+    // Only rooms in use are visited, however large the pool has grown
+    for (int i = active_rooms; i >= 0; i = game_rooms[i].next_active) {
+        GameRoom *game_room = &game_rooms[i];
+        int room_id = (int)((game_room->generation & ROOM_GENERATION_MASK) << ROOM_INDEX_BITS) | i;
+        char game_entry[128];
+        snprintf(game_entry, sizeof(game_entry), "Room ID: %lld | Players: %s vs %s | Observers: %d\n",
+                 global_room_id(room_id),
+                 player_name(game_room, 0),
+                 player_name(game_room, 1),
+                 game_room->observer_count);
+        strncat(buffer, game_entry, size - strlen(buffer) - 1);
+    }
+}
+
+static void list_ongoing_games(int client_index) {
+    Client *client = &clients[client_index];
+
+    // Every reactor describes its own rooms; the answer is sent once all have replied
+    if (!client->games_listing) {
+        client->games_listing = malloc(BUF_SIZE);
+        if (!client->games_listing) {
+            perror("malloc failed");
+            exit(EXIT_FAILURE);
+        }
+    }
+    strcpy(client->games_listing, "Currently ongoing games:\n");
+    client->listing_parts = reactor_count();
+
+    for (int r = 0; r < reactor_count(); r++) {
+        reactor_post(r, &new_message(MSG_LIST_GAMES, client_index)->link);
+    }
+}
+
+static void add_games_part(int client_index, const char *part) {
+    Client *client = &clients[client_index];
+    if (!client->games_listing || client->listing_parts == 0) {
+        return;
+    }
+
+    strncat(client->games_listing, part, BUF_SIZE - strlen(client->games_listing) - 1);
+    if (--client->listing_parts > 0) {
+        return;
+    }
+
+    if (strlen(client->games_listing) == strlen("Currently ongoing games:\n")) {
+        strncat(client->games_listing, "No ongoing games.\n", BUF_SIZE - strlen(client->games_listing) - 1);
+    }
+
+    write_client(client->sock, client->games_listing);
+    free(client->games_listing);
+    client->games_listing = NULL;
+}
+
+static void observe_game(int client_index, int room_id) {
+    GameRoom *game_room = room_from_id(room_id);
+
+    if (!game_room) {
+        write_client(clients[client_index].sock, "No active game in this room.\n");
+        return;
+    }
+      // Check if the room is "friends-only"
     if (game_room->friends_only) {
         int is_friend = are_friends(clients[client_index].name, 
-                                    clients[game_room->player_index[0]].name) ||
+                                    player_name(game_room, 0)) ||
                         are_friends(clients[client_index].name, 
-                                    clients[game_room->player_index[1]].name);
+                                    player_name(game_room, 1));
 
         if (!is_friend) {
             write_client(clients[client_index].sock, "You can only observe games where you're friends with a player.\n");
@@ -925,22 +1541,20 @@ static void observe_game(int client_index, int room_id) {
         }
     }
 
-    add_observer(room_id, clients[client_index].sock, client_index);
+    add_observer(room_id, client_index);
 }
 
 static void toggle_friends_only(int client_index) {
-    int room_id = clients[client_index].room_id;
+    GameRoom *game_room = room_from_id(clients[client_index].room_id);
 
-    if (room_id < 0 || room_id >= MAX_CLIENTS) {
+    if (!game_room) {
         write_client(clients[client_index].sock, "You are not in a game room.\n");
         return;
     }
 
-    GameRoom *game_room = &game_rooms[room_id];
-
     // Check if the client is one of the players
-    if (game_room->player_sockets[0] != clients[client_index].sock &&
-        game_room->player_sockets[1] != clients[client_index].sock) {
+    ClientHandle handle = handle_of(client_index);
+    if (game_room->players[0] != handle && game_room->players[1] != handle) {
         write_client(clients[client_index].sock, "Only players can toggle spectator privacy.\n");
         return;
     }
@@ -1001,13 +1615,13 @@ static void replay_game(int client_index, const char *game_filename) {
     write_client(clients[client_index].sock, "End of game replay.\n");
 }
 
-typedef struct {
-    char **states;  // Array of game states
-    int count;      // Total number of states
-    int current;    // Current state index
-} ReplaySession;
-
-static ReplaySession replay_sessions[MAX_CLIENTS];
+static void free_replay_session(ReplaySession *session) {
+    for (int k = 0; k < session->count; k++) {
+        free(session->states[k]);
+    }
+    free(session->states);
+    memset(session, 0, sizeof(*session));
+}
 
 void start_replay_session(int client_index, const char *game_filename) {
     char filepath[512];
@@ -1020,23 +1634,39 @@ void start_replay_session(int client_index, const char *game_filename) {
     }
 
     char line[BUF_SIZE];
-    ReplaySession *session = &replay_sessions[client_index];
-    session->count = 0;
-    session->current = 0;
-    session->states = malloc(sizeof(char *) * 100);  // Max 100 states
+    ReplaySession *session = &clients[client_index].replay;
+    free_replay_session(session);
 
     while (fgets(line, sizeof(line), file)) {
+        if (session->count == session->capacity) {
+            int new_capacity = session->capacity ? session->capacity * 2 : 100;
+            char **grown = realloc(session->states, new_capacity * sizeof(char *));
+            if (!grown) {
+                perror("realloc failed");
+                exit(EXIT_FAILURE);
+            }
+            session->states = grown;
+            session->capacity = new_capacity;
+        }
         session->states[session->count] = strdup(line);
         session->count++;
     }
 
     fclose(file);
+    if (session->count == 0) {
+        write_client(clients[client_index].sock, "The game file is empty.\n");
+        return;
+    }
     write_client(clients[client_index].sock, "Replay session started. Use 'next' or 'prev' to navigate.\n");
     write_client(clients[client_index].sock, session->states[0]);  // Display first state
 }
 
 void navigate_replay_session(int client_index, const char *command) {
-    ReplaySession *session = &replay_sessions[client_index];
+    ReplaySession *session = &clients[client_index].replay;
+    if (session->count == 0) {
+        write_client(clients[client_index].sock, "No replay session started. Use 'replay <filename>' first.\n");
+        return;
+    }
 
     if (strcmp(command, "next") == 0) {
         if (session->current + 1 < session->count) {
@@ -1059,137 +1689,84 @@ void navigate_replay_session(int client_index, const char *command) {
 
 //elo ranking system
 
-static void get_top_elo(char *output, size_t output_size) {
-    FILE *file = fopen("Database/players.txt", "r");
-    if (!file) {
-        perror("Failed to open players database");
-        snprintf(output, output_size, "Unable to fetch top players at the moment.\n");
-        return;
-    }
-
-    char names[100][32];  // Maximum of 100 players, with max 32 chars for names
-    int elos[100];
-    int count = 0;
-
-    // Read players from the file
-    while (fscanf(file, "%31s %d", names[count], &elos[count]) == 2) {
-        count++;
-    }
-    fclose(file);
-
-    // Sort players by ELO in descending order
-    for (int i = 0; i < count - 1; i++) {
-        for (int j = i + 1; j < count; j++) {
-            if (elos[i] < elos[j]) {
-                // Swap ELOs
-                int temp_elo = elos[i];
-                elos[i] = elos[j];
-                elos[j] = temp_elo;
-
-                // Swap names
-                char temp_name[32];
-                strncpy(temp_name, names[i], sizeof(temp_name));
-                strncpy(names[i], names[j], sizeof(names[i]));
-                strncpy(names[j], temp_name, sizeof(names[j]));
-            }
-        }
+// The top 5 (page 0) or one page of the full ranking, formatted at most once
+// per rating change by each reactor
+static const char *ranking_text(int page) {
+    RankingPage *cached = &ranking_cache[page % RANKING_CACHE_PAGES];
+    uint64_t version = players_version();
+    if (cached->version == version && cached->page == page) {
+        return cached->text;
+    }
+
+    PlayerRating ranked[RANKING_PAGE_SIZE];
+    int first = page == 0 ? 1 : (page - 1) * RANKING_PAGE_SIZE + 1;
+    int count = players_range(first, ranked, page == 0 ? 5 : RANKING_PAGE_SIZE);
+    char *output = cached->text;
+    size_t output_size = sizeof(cached->text);
+    if (page == 0) {
+        snprintf(output, output_size, "Top 5 Players:\n");
+    } else if (count == 0) {
+        int pages = (players_count() + RANKING_PAGE_SIZE - 1) / RANKING_PAGE_SIZE;
+        snprintf(output, output_size, "There is no page %d, the ranking has %d.\n", page, pages);
+    } else {
+        int pages = (players_count() + RANKING_PAGE_SIZE - 1) / RANKING_PAGE_SIZE;
+        snprintf(output, output_size, "Ranking, page %d of %d:\n", page, pages);
     }
-
-    // Format the top 5 players
-    snprintf(output, output_size, "Top 5 Players:\n");
-    for (int i = 0; i < count && i < 5; i++) {
+    for (int i = 0; i < count; i++) {
         char line[64];
-        snprintf(line, sizeof(line), "%d. %s: %d ELO\n", i + 1, names[i], elos[i]);
+        snprintf(line, sizeof(line), "%d. %s: %d ELO\n", first + i, ranked[i].name, ranked[i].elo);
         strncat(output, line, output_size - strlen(output) - 1);
     }
+    cached->version = version;
+    cached->page = page;
+    return cached->text;
 }
 
-void update_player_elo(const char *player_name, int result) {
-    // result: 1 for win, -1 for loss
-    const int elo_change = 30; // Points added/subtracted per game
-    const char *file_path = "Database/players.txt";
-
-    FILE *file = fopen(file_path, "r");
-    if (!file) {
-        perror("Failed to open players database for reading");
-        return;
-    }
-
-    char temp_file_path[] = "Database/players_temp.txt";
-    FILE *temp_file = fopen(temp_file_path, "w");
-    if (!temp_file) {
-        perror("Failed to open temporary file for writing");
-        fclose(file);
-        return;
-    }
-
-    char name[32];
-    int elo;
-    int found = 0;
-
-    // Read each line, update the player's ELO if found, and write to the temp file
-    while (fscanf(file, "%31s %d", name, &elo) == 2) {
-        if (strcmp(name, player_name) == 0) {
-            elo += result * elo_change; // Update the ELO based on the result
-            found = 1;
-        }
-        fprintf(temp_file, "%s %d\n", name, elo);
-    }
-
-    // If the player was not found, add them to the file with a starting ELO
-    if (!found) {
-        int initial_elo = 1000 + result * elo_change;
-        fprintf(temp_file, "%s %d\n", player_name, initial_elo);
-    }
-
-    fclose(file);
-    fclose(temp_file);
+static void send_rank(int client_index) {
+    char buffer[BUF_SIZE];
+    snprintf(buffer, BUF_SIZE, "Your rank: %d of %d (%d ELO). Type 'top <page>' to browse the full ranking.\n",
+             players_rank(clients[client_index].name), players_count(), players_elo(clients[client_index].name));
+    write_client(clients[client_index].sock, buffer);
+}
 
-    // Replace the original file with the updated one
-    if (remove(file_path) != 0) {
-        perror("Failed to remove original players database");
-        return;
-    }
-    if (rename(temp_file_path, file_path) != 0) {
-        perror("Failed to rename temporary file to players database");
-    }
+void record_game_result(const char *winner, const char *loser) {
+    const int elo_change = 30; // Points added/subtracted per game
+    players_record_result(winner, loser, elo_change);
 }
 
 int get_elo_rating(const char *player_name){
-    FILE *file = fopen("Database/players.txt", "r");
-    if (!file) {
-        perror("Failed to open players database");
-        return 0;
-    }
+    return players_elo(player_name);
+}
 
-    char name[32];
-    int elo;
-    while (fscanf(file, "%31s %d", name, &elo) == 2) {
-        if (strcmp(name, player_name) == 0) {
-            fclose(file);
-            return elo;
-        }
-    }
 
-    fclose(file);
-    return 0;
+// Answers to a prompt come back through the event loop like any other command
+static void handle_prompt_reply(int client_index, char *buffer) {
+    ClientState state = clients[client_index].state;
+    clients[client_index].state = STATE_MENU;
+
+    switch (state) {
+    case STATE_SET_BIO:
+        complete_set_bio(client_index, buffer);
+        break;
+    case STATE_VIEW_BIO:
+        complete_view_bio(client_index, buffer);
+        break;
+    case STATE_SEND_FRIEND_REQUEST:
+        complete_send_friend_request(client_index, buffer);
+        break;
+    case STATE_ANSWER_FRIEND_REQUEST:
+        complete_accept_friend_request(client_index, buffer);
+        break;
+    default:
+        return;
+    }
+    send_welcome_message(&clients[client_index]);
 }
 
-
-static void handle_outside_room(int client_index, char *buffer, int actual) {
+static void handle_outside_room(int client_index, char *buffer, int *actual) {
     if (clients[client_index].observing) {
         if (strcmp(buffer, "exit") == 0) {
-            // Remove the client from the observers list
-            GameRoom *game_room = &game_rooms[clients[client_index].room_id];
-            for (int j = 0; j < MAX_CLIENTS; j++) {
-                if (game_room->observers[j] == clients[client_index].sock) {
-                    game_room->observers[j] = 0;
-                    break;
-                }
-            }
-
-            clients[client_index].observing = 0;
-            clients[client_index].room_id = -1;
+            remove_observer(client_index);
 
             write_client(clients[client_index].sock, "You have left observation mode.\n");
             send_welcome_message(&clients[client_index]);
@@ -1199,40 +1776,53 @@ static void handle_outside_room(int client_index, char *buffer, int actual) {
     }else if (clients[client_index].waiting_for_response) {
             char *target_name = buffer;
             target_name[strcspn(target_name, "\n")] = '\0';
-            send_duel_request(client_index, target_name, actual);
+            send_duel_request(client_index, target_name);
     } else if(strcmp(buffer, "1") == 0) {
-        send_player_list(clients, actual, client_index);
+        send_player_list(clients, client_index);
         send_welcome_message(&clients[client_index]);
     } else if (strcmp(buffer, "2") == 0) {
         write_client(clients[client_index].sock, "Disconnecting...\n");
-        handle_disconnection(client_index, &actual);
+        handle_disconnection(client_index, actual);
     } else if (strcmp(buffer, "3") == 0) {
-        handle_join_game(client_index, actual);
+        handle_join_game(client_index);
     } else if (strcmp(buffer, "4") == 0) {
         handle_set_bio(client_index);
-        send_welcome_message(&clients[client_index]);
     } else if (strcmp(buffer, "5") == 0) {
-        handle_view_bio(client_index, actual);
-        send_welcome_message(&clients[client_index]);
+        handle_view_bio(client_index);
     } else if (strcmp(buffer, "6") == 0) {
         list_ongoing_games(client_index);        
     } else if (strcmp(buffer, "7") ==0){
         handle_send_friend_request(client_index);
-        send_welcome_message(&clients[client_index]);
     } else if (strcmp(buffer, "8") == 0) {
-        handle_accept_friend_request(client_index);
-        send_welcome_message(&clients[client_index]);
+        if (!handle_accept_friend_request(client_index)) {
+            send_welcome_message(&clients[client_index]);
+        }
     } else if (strcmp(buffer, "9") == 0) {
         handle_view_friends_list(client_index);
         send_welcome_message(&clients[client_index]);
     } else if (strcmp(buffer, "10") == 0) {
-        char top_players[BUF_SIZE];
-        get_top_elo(top_players, sizeof(top_players));
-        write_client(clients[client_index].sock, top_players);
+        write_client(clients[client_index].sock, ranking_text(0));
+        send_rank(client_index);
         send_welcome_message(&clients[client_index]);
+    } else if (strncmp(buffer, "top ", 4) == 0) {
+        // Clamped before ranking_text() turns it into an offset
+        long page = strtol(buffer + 4, NULL, 10);
+        long last_page = (players_count() + RANKING_PAGE_SIZE - 1) / RANKING_PAGE_SIZE;
+        page = page > last_page ? last_page : page;
+        page = page < 1 ? 1 : page;
+        write_client(clients[client_index].sock, ranking_text((int)page));
+    } else if (strcmp(buffer, "11") == 0) {
+        start_bot_game(client_index);
     }else if (strncmp(buffer, "observe ", 8) == 0) {
-        int room_id = atoi(buffer + 8);
-        observe_game(client_index, room_id);
+        long long global_id = strtoll(buffer + 8, NULL, 10);
+        int owner = global_id >= 0 ? (int)(global_id % reactor_count()) : reactor_id;
+        int room_id = global_id >= 0 && global_id / reactor_count() <= INT_MAX ? (int)(global_id / reactor_count()) : -1;
+        if (owner != reactor_id && room_id >= 0) {
+            // Observers live on the reactor that owns the room
+            migrate_client(client_index, actual, owner, ADOPT_OBSERVE, room_id);
+        } else {
+            observe_game(client_index, room_id);
+        }
     } else if (strcmp(buffer, "list games") == 0) {
         list_saved_games(client_index);
     } else if (strncmp(buffer, "replay ", 7) == 0) {
@@ -1241,32 +1831,27 @@ static void handle_outside_room(int client_index, char *buffer, int actual) {
     } else if (strcmp(buffer, "next") == 0 || strcmp(buffer, "prev") == 0) {
         navigate_replay_session(client_index, buffer);
     } else if (strcmp(buffer, "accept") == 0) {
-        for (int j = 0; j < actual; j++) {
-            if (clients[j].room_id == clients[client_index].room_id && j != client_index && clients[j].in_room == 0) {
-                start_private_chat(client_index, j);
-                break;
-            }
+        if (clients[client_index].duel_handle != NO_CLIENT) {
+            // The requester's reactor sends it over; the room is hosted here
+            Message *msg = new_message(MSG_DUEL_ANSWER, client_index);
+            msg->to_handle = clients[client_index].duel_handle;
+            msg->arg = reactor_id;
+            reactor_post(clients[client_index].duel_reactor, &msg->link);
         }
     } else if (strcmp(buffer, "refuse") == 0) {
-        for (int j = 0; j < actual; j++) { // Loop through all connected clients
-            if (clients[j].room_id == clients[client_index].room_id && j != client_index && clients[j].in_room == 0) {
-                // Notify the requester about the refusal
-                char refuse_msg[BUF_SIZE];
-                snprintf(refuse_msg, sizeof(refuse_msg), "Your game request was refused by %s.\n", clients[client_index].name);
-                write_client(clients[j].sock, refuse_msg);
-
-                // Reset the room state for both clients
-                clients[j].room_id = -1;
-                clients[j].in_room = 0;
-                clients[j].waiting_for_response = 0;
-
-                clients[client_index].room_id = -1;
-                clients[client_index].in_room = 0;
-
-                // Notify the refusing client about the action
-                write_client(clients[client_index].sock, "You refused the game request.\n");
-                break; // Exit the loop after processing the refusal
-            }
+        if (clients[client_index].duel_handle != NO_CLIENT) {
+            // The requester is notified and reset by its own reactor
+            Message *msg = new_message(MSG_DUEL_ANSWER, client_index);
+            msg->to_handle = clients[client_index].duel_handle;
+            msg->arg = -1;
+            reactor_post(clients[client_index].duel_reactor, &msg->link);
+
+            clients[client_index].duel_handle = NO_CLIENT;
+            clients[client_index].room_id = -1;
+            clients[client_index].in_room = 0;
+
+            // Notify the refusing client about the action
+            write_client(clients[client_index].sock, "You refused the game request.\n");
         }
     } else{
         write_client(clients[client_index].sock, "Invalid option. Choose again.\n");
@@ -1274,15 +1859,65 @@ static void handle_outside_room(int client_index, char *buffer, int actual) {
     }
 }
 
-static void handle_in_room(int client_index, char *buffer) {
-    int room_id = clients[client_index].room_id;
+// Plays seat's move (pit 1-6), already checked against the rules, and tells the room.
+// The game either ends here or passes to the other seat.
+static void play_move(int room_id, int seat, int move) {
+    GameRoom *game_room = room_from_id(room_id);
+    Board board;
+    board_from_plateau(&board, &game_room->board);
+    rules_play(&board, seat, move - 1);
+    int over = rules_game_over(&board, 1 - seat);
+    board_to_plateau(&board, &game_room->board);
+
+    // Binary clients get the move and the new board in 22 bytes instead of the art
+    char frame[PROTO_HEADER + 2 + PROTO_BOARD_SIZE];
+    size_t frame_len = proto_move(frame, seat, move);
+    frame_len += proto_board(frame + frame_len, &game_room->board);
+    send_room_board(room_id, frame, frame_len);
+    save_game_state(game_room);
+    if (!over) {
+        annotate_endgame(game_room, &board, 1 - seat);
+    }
+
+    if (over) {
+        int winner = rules_winner(&board);
+        // Scores over half the seeds end the game; otherwise the next player could not move
+        int reason = board.score[seat] > MAX_GRAINS / 2 || board.score[1 - seat] > MAX_GRAINS / 2
+                     ? RESULT_CAPTURE : RESULT_NO_MOVES;
+        char end_msg[BUF_SIZE];
+        if (winner == RULES_DRAW) {
+            snprintf(end_msg, BUF_SIZE, "Draw, %d seeds each!\n", board.score[0]);
+        } else {
+            snprintf(end_msg, BUF_SIZE, "Player %s wins %d to %d!\n", player_name(game_room, winner),
+                     board.score[winner], board.score[1 - winner]);
+            if (game_room->bot_seat < 0) {
+                record_game_result(player_name(game_room, winner), player_name(game_room, 1 - winner));
+            }
+        }
 
-    if (room_id < 0 || room_id >= MAX_CLIENTS) {
-        write_client(clients[client_index].sock, "Invalid room ID.\n");
-        return;
+        frame_len = proto_result(frame, winner == RULES_DRAW ? PROTO_NO_SEAT : winner, reason);
+        send_room_event(room_id, end_msg, frame, frame_len);
+        finalize_game_file(game_room, end_msg); // Replace with actual result
+
+        // Both players and the observers go back to the menu
+        close_room(room_id);
+    } else {
+        game_room->current_turn = 1 - seat;
+        char turn_msg[BUF_SIZE];
+        snprintf(turn_msg, BUF_SIZE, "Player %s made a move. It's now Player %s's turn.\n",
+                 player_name(game_room, seat),
+                 player_name(game_room, game_room->current_turn));
+        send_room_event(room_id, turn_msg, NULL, 0);
+        announce_turn(room_id, "Your turn! Use /1 to /6 or /-1 to exit.\n");
+        if (game_room->current_turn == game_room->bot_seat) {
+            request_bot_move(room_id);
+        }
     }
+}
 
-    GameRoom *game_room = &game_rooms[room_id];
+static void handle_in_room(int client_index, char *buffer) {
+    int room_id = clients[client_index].room_id;
+    GameRoom *game_room = room_from_id(room_id);
 
     if (game_room == NULL) {
         write_client(clients[client_index].sock, "Game room does not exist.\n");
@@ -1298,27 +1933,7 @@ static void handle_in_room(int client_index, char *buffer) {
         int move = atoi(buffer + 1);  // Skip the '/' prefix
         if (move == -1) {
             // End game if a player inputs -1
-            int opponent_index = game_room->player_index[1 - game_room->current_turn];
-            char end_msg[BUF_SIZE];
-            snprintf(end_msg, BUF_SIZE, "Player %s disconnected. You won!\n", clients[client_index].name);
-            update_player_elo(clients[client_index].name, -1);
-            update_player_elo(clients[opponent_index].name, 1);
-            notify_observers(room_id, end_msg);
-            finalize_game_file(game_room, end_msg); // Replace with actual result
-
-            // Notify the opponent
-            write_client(game_room->player_sockets[1 - game_room->current_turn], end_msg);
-
-            // Reset both players
-            clients[client_index].in_room = 0;
-            clients[client_index].room_id = -1;
-            clients[opponent_index].in_room = 0;
-            clients[opponent_index].room_id = -1;
-
-            // Reset game room state
-            memset(game_room, 0, sizeof(GameRoom));
-            send_welcome_message(&clients[client_index]);
-            send_welcome_message(&clients[opponent_index]);
+            forfeit_game(client_index);
             return;
         }
 
@@ -1327,42 +1942,17 @@ static void handle_in_room(int client_index, char *buffer) {
             return;
         }
 
-        if (clients[client_index].sock == game_room->player_sockets[game_room->current_turn]) {
-            int result = jouer_coup(&game_room->board, game_room->current_turn, move - 1);
-            char *board_state = afficher_plateau(&game_room->board);
-            send_to_room(room_id, board_state);
-            notify_observers(room_id, board_state);
-            save_game_state(game_room);
-            free(board_state);
-
-            if (result) {
-                int opponent_index = game_room->player_index[1 - game_room->current_turn];
-                char end_msg[BUF_SIZE];
-                snprintf(end_msg, BUF_SIZE, "Player %s wins!\n", clients[client_index].name);
-                update_player_elo(clients[client_index].name, 1);
-                update_player_elo(clients[opponent_index].name, -1);
-
-                send_to_room(room_id, end_msg);
-                finalize_game_file(game_room, end_msg); // Replace with actual result
-                notify_observers(room_id, end_msg);
-
-                // Reset both players
-                clients[game_room->player_index[0]].in_room = 0;
-                clients[game_room->player_index[0]].room_id = -1;
-                clients[game_room->player_index[1]].in_room = 0;
-                clients[game_room->player_index[1]].room_id = -1;
-
-                // Reset game room state
-                memset(game_room, 0, sizeof(GameRoom));
-            } else {
-                game_room->current_turn = 1 - game_room->current_turn;
-                snprintf(buffer, BUF_SIZE, "Player %s made a move. It's now Player %s's turn.\n",
-                         clients[client_index].name,
-                         clients[game_room->player_index[game_room->current_turn]].name);
-                send_to_room(room_id, buffer);
-                notify_observers(room_id, buffer);
-                write_client(game_room->player_sockets[game_room->current_turn], "Your turn! Use /1 to /6 or /-1 to exit.\n");
+        if (handle_of(client_index) == game_room->players[game_room->current_turn]) {
+            int seat = game_room->current_turn;
+            Board board;
+            board_from_plateau(&board, &game_room->board);
+            if (!(rules_legal_mask(&board, seat) & (1 << (move - 1)))) {
+                write_client(clients[client_index].sock, board.pits[seat * 6 + move - 1] == 0
+                             ? "Illegal move: that pit is empty.\n"
+                             : "Illegal move: your opponent has no seeds, you must give them some.\n");
+                return;
             }
+            play_move(room_id, seat, move);
         } else {
             write_client(clients[client_index].sock, "Not your turn. Wait for the other player.\n");
         }
@@ -1375,66 +1965,291 @@ static void handle_in_room(int client_index, char *buffer) {
 }
 
 
-static void app(void) {
-    SOCKET sock = init_connection();
-    char buffer[BUF_SIZE];
-    int actual = 0;
-    int max = sock;
-    fd_set rdfs;
+static void mark_pending(int client_index) {
+    Client *client = &clients[client_index];
+    if (client->pending) {
+        return;
+    }
+    if (pending_count == pending_capacity) {
+        int new_capacity = pending_capacity ? pending_capacity * 2 : 64;
+        ClientHandle *grown = realloc(pending_clients, new_capacity * sizeof(ClientHandle));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        pending_clients = grown;
+        pending_capacity = new_capacity;
+    }
+    pending_clients[pending_count++] = handle_of(client_index);
+    client->pending = 1;
+}
 
-    while (1) {
-        FD_ZERO(&rdfs);
-        FD_SET(STDIN_FILENO, &rdfs);
-        FD_SET(sock, &rdfs);
+static void set_want_write(int client_index, int want_write) {
+    Client *client = &clients[client_index];
+    if (client->want_write == want_write) {
+        return;
+    }
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.u64 = handle_of(client_index);
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->sock, &ev) == -1) {
+        perror("epoll_ctl()");
+        return;
+    }
+    client->want_write = want_write;
+}
 
-        for (int i = 0; i < actual; i++) {
-            FD_SET(clients[i].sock, &rdfs);
-            if (clients[i].sock > max) max = clients[i].sock;
+// Everything one pass of handlers queued for a client leaves in a single writev()
+static void flush_pending(int *actual) {
+    for (int p = 0; p < pending_count; p++) {
+        int i = client_from_handle(pending_clients[p]);
+        if (i < 0) {
+            continue;
         }
+        clients[i].pending = 0;
 
-        if (select(max + 1, &rdfs, NULL, NULL, NULL) == -1) {
-            perror("select()");
-            exit(errno);
+        int status = clients[i].closing ? -1 : outq_flush(&clients[i].out, clients[i].sock);
+        if (status < 0) {
+            if (clients[i].closing) {
+                fprintf(stderr, "Dropping %s: output queue over %d bytes\n", clients[i].name, OUTQ_HIGH_WATER);
+            }
+            handle_disconnection(i, actual);
+        } else {
+            set_want_write(i, status == 0);
         }
+    }
+    pending_count = 0;
+}
+
+// Extracts the client's next command as a text line; binary MOVE frames become
+// the equivalent "/<pit>" command. Returns 1, 0 if none is complete yet, -1 if malformed.
+static int next_command(Client *client, char *buffer, size_t size) {
+    if (!client->binary) {
+        return inring_next_line(&client->in, buffer, size);
+    }
+
+    int opcode;
+    size_t len;
+    int status = proto_next_frame(&client->in, &opcode, buffer, size - 1, &len);
+    if (status <= 0) {
+        return status;
+    }
+
+    if (opcode == OP_TEXT) {
+        buffer[len] = '\0';
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        return 1;
+    }
+    if (opcode == OP_MOVE && len == 1) {
+        int pit = (unsigned char)buffer[0];
+        snprintf(buffer, size, "/%d", pit == 0 ? -1 : pit);
+        return 1;
+    }
+    return -1;
+}
+
+// Runs every complete command buffered for the client, in arrival order
+static void dispatch_commands(ClientHandle handle, int *actual) {
+    char buffer[BUF_SIZE];
+    int i;
 
-        if (FD_ISSET(STDIN_FILENO, &rdfs)) {
+    // A handler may disconnect or migrate the client, so resolve it again before each line
+    while ((i = client_from_handle(handle)) >= 0 && !clients[i].closing) {
+        int status = next_command(&clients[i], buffer, sizeof(buffer));
+        if (status == 0) {
             break;
-        } else if (FD_ISSET(sock, &rdfs)) {
-            handle_new_connection(sock, &actual);
+        }
+        if (status < 0) {
+            fprintf(stderr, "Dropping %s: malformed command or longer than %d bytes\n", clients[i].name, BUF_SIZE - 1);
+            handle_disconnection(i, actual);
+            break;
+        }
+
+        if (clients[i].state == STATE_LOGIN) {
+            complete_login(i, buffer);
+        } else if (clients[i].state != STATE_MENU) {
+            handle_prompt_reply(i, buffer);
+        } else if (clients[i].in_room) {
+            handle_in_room(i, buffer);
         } else {
-            for (int i = 0; i < actual; i++) {
-                if (FD_ISSET(clients[i].sock, &rdfs)) {
-                    int n = read_client(clients[i].sock, buffer);
-                    if (n <= 0) {
-                        handle_disconnection(i, &actual);
-                    } else {
-                        buffer[n] = '\0';
-                        if (clients[i].in_room) {
-                            handle_in_room(i, buffer);
-                        } else {
-                            handle_outside_room(i, buffer, actual);
-                        }
-                    }
-                }
+            handle_outside_room(i, buffer, actual);
+        }
+    }
+}
+
+static void handle_client_input(int client_index, int *actual) {
+    ClientHandle handle = handle_of(client_index);
+    int n = inring_recv(&clients[client_index].in, clients[client_index].sock);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return;
+    }
+    if (n < 0 && errno == ENOBUFS) {
+        // Ring full of complete lines is impossible, so this is an oversized command
+        dispatch_commands(handle, actual);
+        return;
+    }
+    if (n <= 0) {
+        if (n < 0) {
+            perror("recv()");
+        }
+        handle_disconnection(client_index, actual);
+        return;
+    }
+
+    dispatch_commands(handle, actual);
+}
+
+// Clients are registered under their handle; the two fixed sockets use tokens no handle can take
+#define WAKE_TOKEN 0
+#define LISTEN_TOKEN 1
+
+static void watch_socket(SOCKET sock, uint64_t token) {
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.u64 = token;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev) == -1) {
+        perror("epoll_ctl()");
+        exit(errno);
+    }
+}
+
+static void *reactor_main(void *arg) {
+    reactor_id = (int)(intptr_t)arg;
+    // Every reactor listens on the port; the kernel spreads connections between them
+    SOCKET sock = init_connection();
+    int wake_fd = reactor_wake_fd(reactor_id);
+    int actual = 0;
+    struct epoll_event events[MAX_EVENTS];
+
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd == -1) {
+        perror("epoll_create1()");
+        exit(errno);
+    }
+    // Sockets are registered once; each wakeup only reports the ready ones
+    watch_socket(wake_fd, WAKE_TOKEN);
+    watch_socket(sock, LISTEN_TOKEN);
+
+    while (!reactor_stopping()) {
+        // Sleep no longer than the next login deadline
+        int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timer_next_timeout(&timers, timer_now()));
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
             }
+            perror("epoll_wait()");
+            exit(errno);
         }
+
+        for (int e = 0; e < ready; e++) {
+            uint64_t token = events[e].data.u64;
+            int i;
+
+            if (token == WAKE_TOKEN) {
+                handle_mailbox(&actual);
+                continue;
+            } else if (token == LISTEN_TOKEN) {
+                handle_new_connection(sock, &actual);
+                continue;
+            }
+
+            // An earlier event of this batch may have dropped the client, leaving the handle stale
+            i = client_from_handle(token);
+            if (i >= 0 && (events[e].events & EPOLLOUT)) {
+                mark_pending(i);
+            }
+            if (i < 0 || !(events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                continue;
+            }
+
+            handle_client_input(i, &actual);
+        }
+
+        expire_timers(&actual);
+        flush_pending(&actual);
     }
 
-    clear_clients(clients, actual);
+    clear_clients(clients, clients_capacity);
+    free(clients);
+    free(client_of_fd);
+    free(pending_clients);
+    timer_clear(&timers);
+    for (int i = 0; i < RENDER_CACHE_SIZE; i++) {
+        sharedbuf_release(render_cache[i].text);
+    }
+    for (int i = 0; i < rooms_capacity; i++) {
+        free(game_rooms[i].observers);
+    }
+    free(game_rooms);
+    close(epoll_fd);
     end_connection(sock);
+    return NULL;
 }
 
+static void app(int num_reactors) {
+    pthread_t *threads = malloc(num_reactors * sizeof(pthread_t));
+    if (!threads) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
 
+    reactor_init(num_reactors);
+    if (players_open() != 0 || friends_open() != 0) {
+        exit(EXIT_FAILURE);
+    }
+    egdb_open(EGDB_FILE); // Optional: built offline by awale_egdb_gen
+    book_open(BOOK_FILE); // Optional: built by awale_book from the finished games
+    bot_start(BOT_THREADS);
+    for (int r = 0; r < num_reactors; r++) {
+        if (pthread_create(&threads[r], NULL, reactor_main, (void *)(intptr_t)r) != 0) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Any input on the console stops the server
+    char c;
+    while (read(STDIN_FILENO, &c, 1) < 0 && errno == EINTR) {
+    }
 
-static void clear_clients(Client *clients, int actual) {
-    for (int i = 0; i < actual; i++) {
+    // Searches still running post their moves before the reactors go away
+    bot_stop();
+    reactor_stop_all();
+    for (int r = 0; r < num_reactors; r++) {
+        pthread_join(threads[r], NULL);
+    }
+    free(threads);
+    egdb_close();
+    book_close();
+    players_close();
+    friends_close();
+}
+
+static void clear_clients(Client *clients, int capacity) {
+    for (int i = 0; i < capacity; i++) {
+        if (!clients[i].live) {
+            continue;
+        }
+        lobby_remove(clients[i].sock);
+        outq_clear(&clients[i].out);
+        free(clients[i].games_listing);
+        free_replay_session(&clients[i].replay);
         close(clients[i].sock);
     }
 }
 
 static void remove_client(Client *clients, int to_remove, int *actual) {
+    // Leave the lobby before the descriptor can be reused by another reactor
+    lobby_remove(clients[to_remove].sock);
+    client_of_fd[clients[to_remove].sock] = -1;
+    outq_clear(&clients[to_remove].out);
+    free(clients[to_remove].games_listing);
+    free_replay_session(&clients[to_remove].replay);
+    // Closing the descriptor also drops it from the epoll set
     close(clients[to_remove].sock);
-    memmove(clients + to_remove, clients + to_remove + 1, (*actual - to_remove - 1) * sizeof(Client));
+    // Other slots stay where they are; only handles to this one go stale
+    release_client_slot(to_remove);
     (*actual)--;
 }
 
@@ -1450,54 +2265,119 @@ int init_connection(void) {
     sin.sin_port = htons(PORT);
     sin.sin_family = AF_INET;
 
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == SOCKET_ERROR) {
+        perror("setsockopt()");
+        exit(errno);
+    }
+
     if (bind(sock, (SOCKADDR *)&sin, sizeof(sin)) == SOCKET_ERROR) {
         perror("bind()");
         exit(errno);
     }
 
-    if (listen(sock, MAX_CLIENTS) == SOCKET_ERROR) {
+    if (listen(sock, SOMAXCONN) == SOCKET_ERROR) {
         perror("listen()");
         exit(errno);
     }
 
+    // Accepting drains the backlog until it would block
+    if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK) == -1) {
+        perror("fcntl()");
+        exit(errno);
+    }
+
     return sock;
 }
 
 void send_to_room(int room_id, const char *buffer) {
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (clients[i].in_room && clients[i].room_id == room_id) {
-            write_client(clients[i].sock, buffer);
-        }
+    GameRoom *game_room = room_from_id(room_id);
+    if (!game_room) {
+        return;
     }
+
+    // Only the two players are in_room with this room_id, no need to scan clients[]
+    Broadcast b = {buffer, NULL, 0, 1, NULL, NULL};
+    broadcast_room(game_room, &b, 1, 0);
 }
 
 void end_connection(int sock) {
     close(sock);
 }
 
-int read_client(SOCKET sock, char *buffer) {
-    int n = recv(sock, buffer, BUF_SIZE - 1, 0);
-    if (n < 0) {
-        perror("recv()");
+void write_client(SOCKET sock,const char *buffer) {
+    int i = find_client(sock);
+    if (i < 0) {
+        // Another reactor owns the socket: the text goes through its mailbox, so that
+        // it is queued and framed like the rest. Mid-migration, it is dropped.
+        int owner;
+        ClientHandle handle;
+        if (lobby_owner(sock, &owner, &handle) && handle != NO_CLIENT) {
+            post_text(owner, handle, "", buffer);
+        }
+        return;
+    }
+
+    size_t len = strlen(buffer);
+    if (clients[i].binary) {
+        // Text reaches binary clients inside TEXT frames
+        char header[PROTO_HEADER];
+        proto_header(header, OP_TEXT, len);
+        queue_output(i, header, PROTO_HEADER);
     }
-    buffer[n] = '\0';
-    return n;
+    queue_output(i, buffer, len);
 }
 
+// People get text, binary clients get frame; either may be NULL to send nothing
+static void write_either(SOCKET sock, const char *text, const char *frame, size_t len) {
+    int i = find_client(sock);
+    if (i >= 0 && clients[i].binary) {
+        if (frame) {
+            queue_output(i, frame, len);
+        }
+    } else if (text) {
+        write_client(sock, text);
+    }
+}
 
+static void queue_shared(int client_index, SharedBuf *buf) {
+    Client *client = &clients[client_index];
+    if (client->closing) {
+        return;
+    }
+    if (!outq_push_shared(&client->out, buf)) {
+        // The peer stopped reading; drop it at the end of this pass
+        client->closing = 1;
+        outq_clear(&client->out);
+    }
+    mark_pending(client_index);
+}
 
-void write_client(SOCKET sock,const char *buffer) {
-    if (send(sock, buffer, strlen(buffer), 0) < 0) {
-        perror("send()");
+static void queue_output(int client_index, const char *data, size_t len) {
+    Client *client = &clients[client_index];
+    if (client->closing) {
+        return;
     }
+    if (!outq_push(&client->out, data, len)) {
+        // The peer stopped reading; drop it at the end of this pass
+        client->closing = 1;
+        outq_clear(&client->out);
+    }
+    mark_pending(client_index);
 }
 
 
 
 
 int main(int argc, char **argv) {
+    // One reactor per core unless told otherwise: ./server [threads]
+    int num_reactors = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_reactors < 1) {
+        num_reactors = 1;
+    }
+
     init();
-    app();
+    app(num_reactors);
     end();
     return EXIT_SUCCESS;
 }
@@ -29,9 +29,16 @@ typedef struct in_addr IN_ADDR;
 
 #define CRLF        "\r\n"
 #define PORT         1977
-#define MAX_CLIENTS     100
+#define ROOM_INDEX_BITS 16   // Room IDs carry the slot in these bits, the generation above
+#define ROOM_GENERATION_MASK 0x7FFF
+#define MAX_EVENTS      64
 
 #define BUF_SIZE    1024
+#define LOGIN_TIMEOUT_MS 10000 // Time a new connection has to send its name
+#define RENDER_CACHE_SIZE 64   // Rendered boards kept per reactor, must be a power of two
+#define RANKING_PAGE_SIZE 10   // Players per page of 'top <page>'
+#define RANKING_CACHE_PAGES 8  // Formatted ranking pages kept per reactor
+#define MAX_LISTED_FRIENDS 100 // Friends shown by the friends list
 
 #include "client2.h"
 
@@ -40,39 +47,63 @@ typedef struct in_addr IN_ADDR;
 
 static void init(void);
 static void end(void);
-static void app(void);
+static void app(int num_reactors);
+static void *reactor_main(void *arg);
 static int init_connection(void);
 static void end_connection(int sock);
-static int read_client(SOCKET sock, char *buffer);
 static void write_client(SOCKET sock, const char *buffer);
+static void write_either(SOCKET sock, const char *text, const char *frame, size_t len);
+static void queue_output(int client_index, const char *data, size_t len);
+static void queue_shared(int client_index, SharedBuf *buf);
 static void send_message_to_all_clients(Client *clients, Client client, int actual, const char *buffer, char from_server);
 static void remove_client(Client *clients, int to_remove, int *actual);
-static void clear_clients(Client *clients, int actual);
+static void mark_pending(int client_index);
+static ClientHandle handle_of(int client_index);
+static int client_from_handle(ClientHandle handle);
+static void flush_pending(int *actual);
+static int next_command(Client *client, char *buffer, size_t size);
+static void request_bot_move(int room_id);
+static void start_bot_game(int client_index);
+static void dispatch_commands(ClientHandle handle, int *actual);
+static void handle_client_input(int client_index, int *actual);
+static void clear_clients(Client *clients, int capacity);
+static void free_replay_session(ReplaySession *session);
 static void send_to_room(int room_id, const char *buffer);
 int fetch_bio(const char *name, char *bio, size_t bio_size);
 void set_bio(const char *name, const char *new_bio);
 static void handle_set_bio(int client_index);
-static void handle_view_bio(int client_index, int actual);
+static void complete_set_bio(int client_index, char *buffer);
+static void handle_view_bio(int client_index);
+static void complete_view_bio(int client_index, const char *buffer);
+static void handle_prompt_reply(int client_index, char *buffer);
 static void handle_new_connection(SOCKET sock, int *actual);
+static void complete_login(int client_index, const char *buffer);
+static void expire_timers(int *actual);
 static void handle_disconnection(int client_index, int *actual);
 static void observe_game(int client_index, int room_id);
 static void list_ongoing_games(int client_index);
+static long long global_room_id(int room_id);
+static void describe_rooms(char *buffer, size_t size);
+static void add_games_part(int client_index, const char *part);
 static void notify_observers(int room_id, const char *message);
-static void send_player_list(Client *clients, int actual, int client_index);
+static void notify_observers_event(int room_id, const char *text, const char *frame, size_t len);
+static void send_player_list(Client *clients, int client_index);
 static void send_welcome_message(Client *client);
-static void handle_join_game(int client_index, int actual);
-static void handle_outside_room(int client_index, char *buffer, int actual);
+static void handle_join_game(int client_index);
+static void handle_outside_room(int client_index, char *buffer, int *actual);
 static void handle_in_room(int client_index, char *buffer);
 static void add_player_to_registry(const char *name);
 int player_exists(const char *name);
-static void add_observer(int room_id, int observer_socket, int c);
+static void add_observer(int room_id, int client_index);
+static void remove_observer(int client_index);
 int are_friends(const char *name1, const char *name2);
-void send_friend_request(const char *sender, const char *receiver);
-int friend_request_exists(const char *sender, const char *receiver);
 static void toggle_friends_only(int client_index);
 static void list_saved_games(int client_index);
 static void replay_game(int client_index, const char *game_filename);
 void start_replay_session(int client_index, const char *game_filename);
 void navigate_replay_session(int client_index, const char *command);
+void record_game_result(const char *winner, const char *loser);
+static const char *ranking_text(int page);
+static void send_rank(int client_index);
 
 #endif /* guard */
@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "sim.h"
+#include "engine.h"
+#include "rules.h"
+
+#define CAMP_SIZE     (CASES / 2)
+#define NO_ORIGIN     0xFF    // Origin of lanes that do not sow this ply
+#define SEARCH_MS     3600000 // Search policies stop on depth, never on time
+
+_Static_assert(SIM_MAX_PLIES < 1024, "Plies must fit in 10 bits of a record");
+
+// Seeds a lane's generator; lanes of one batch get unrelated sequences
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// xorshift64
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// One of the set bits of mask (non-zero), drawn uniformly
+static int random_pit(uint64_t *rng, int mask) {
+    int skip = (int)(next_random(rng) % (uint64_t)__builtin_popcount(mask));
+    while (skip-- > 0) {
+        mask &= mask - 1;
+    }
+    return __builtin_ctz(mask);
+}
+
+static void choose_random(const SimPolicy *policy, SimBatch *batch, const uint16_t *lanes, int count) {
+    (void)policy;
+    for (int i = 0; i < count; i++) {
+        int lane = lanes[i];
+        batch->move[lane] = (uint8_t)random_pit(&batch->rng[lane], batch->legal[lane]);
+    }
+}
+
+// Takes the most seeds now, ties broken at random
+static void choose_greedy(const SimPolicy *policy, SimBatch *batch, const uint16_t *lanes, int count) {
+    (void)policy;
+    for (int i = 0; i < count; i++) {
+        int lane = lanes[i];
+        int joueur = batch->joueur[lane];
+        Board board;
+        sim_lane_board(batch, lane, &board);
+
+        int best = -1;
+        int best_mask = 0;
+        for (int mask = batch->legal[lane]; mask; mask &= mask - 1) {
+            int pit = __builtin_ctz(mask);
+            Board next = board;
+            int captured = rules_play(&next, joueur, pit);
+            if (captured > best) {
+                best = captured;
+                best_mask = 0;
+            }
+            if (captured == best) {
+                best_mask |= 1 << pit;
+            }
+        }
+        batch->move[lane] = (uint8_t)random_pit(&batch->rng[lane], best_mask);
+    }
+}
+
+static void choose_search(const SimPolicy *policy, SimBatch *batch, const uint16_t *lanes, int count) {
+    for (int i = 0; i < count; i++) {
+        int lane = lanes[i];
+        Board board;
+        SearchResult result;
+        sim_lane_board(batch, lane, &board);
+        engine_search(&board, batch->joueur[lane], SEARCH_MS, policy->depth, NULL, &result);
+        if (result.pit < 0 || !(batch->legal[lane] & (1 << result.pit))) {
+            result.pit = random_pit(&batch->rng[lane], batch->legal[lane]);
+        }
+        batch->move[lane] = (uint8_t)result.pit;
+    }
+}
+
+// Fills policy from its name: "random", "greedy" or "search<depth>" (search4 by default).
+// Returns -1 for an unknown name.
+int sim_policy(const char *name, SimPolicy *policy) {
+    memset(policy, 0, sizeof(*policy));
+    if (strlen(name) >= sizeof(policy->name)) {
+        return -1;
+    }
+    strcpy(policy->name, name);
+
+    if (strcmp(name, "random") == 0) {
+        policy->choose = choose_random;
+    } else if (strcmp(name, "greedy") == 0) {
+        policy->choose = choose_greedy;
+    } else if (strncmp(name, "search", 6) == 0) {
+        policy->choose = choose_search;
+        policy->depth = name[6] ? atoi(name + 6) : 4;
+        if (policy->depth < 1 || policy->depth > ENGINE_MAX_DEPTH) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+void sim_batch_init(SimBatch *batch, uint64_t seed) {
+    memset(batch, 0, sizeof(*batch));
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        batch->rng[lane] = splitmix64(&seed) | 1; // xorshift must not start at 0
+        batch->origin[lane] = NO_ORIGIN;
+    }
+}
+
+// Bit i set when pit i of each lane's mover may be played: the same rules as
+// rules_legal_mask(), written as selects so that every lane goes at once
+static void legal_masks(SimBatch *batch) {
+    uint8_t feeding[SIM_LANES];
+    uint8_t opponent[SIM_LANES]; // Non-zero when the opponent has seeds
+
+    memset(batch->legal, 0, sizeof(batch->legal));
+    memset(feeding, 0, sizeof(feeding));
+    memset(opponent, 0, sizeof(opponent));
+    for (int j = 0; j < CAMP_SIZE; j++) {
+        const uint8_t *south = batch->pits[j];
+        const uint8_t *north = batch->pits[CAMP_SIZE + j];
+        for (int lane = 0; lane < SIM_LANES; lane++) {
+            uint8_t own = batch->joueur[lane] ? north[lane] : south[lane];
+            opponent[lane] |= batch->joueur[lane] ? south[lane] : north[lane];
+            batch->legal[lane] |= (uint8_t)((own != 0) << j);
+            feeding[lane] |= (uint8_t)((own >= CAMP_SIZE - j) << j);
+        }
+    }
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        batch->legal[lane] &= opponent[lane] ? 0x3F : feeding[lane];
+    }
+}
+
+// Gives each side the seeds left in its camp
+static void collect_camps(SimBatch *batch, int lane) {
+    for (int i = 0; i < CASES; i++) {
+        batch->score[i / CAMP_SIZE][lane] += batch->pits[i][lane];
+        batch->pits[i][lane] = 0;
+    }
+}
+
+// Decides whether the game in lane is over, the mover's legal pits known
+static void check_end(SimBatch *batch, int lane) {
+    if (batch->score[0][lane] > MAX_GRAINS / 2 || batch->score[1][lane] > MAX_GRAINS / 2) {
+        batch->end[lane] = SIM_END_CAPTURE;
+    } else if (batch->legal[lane] == 0) {
+        batch->end[lane] = SIM_END_NO_MOVES;
+        collect_camps(batch, lane);
+    } else if (batch->plies[lane] >= SIM_MAX_PLIES) {
+        batch->end[lane] = SIM_END_PLY_LIMIT;
+        collect_camps(batch, lane);
+    } else {
+        return;
+    }
+    batch->state[lane] = SIM_OVER;
+    batch->legal[lane] = 0;
+}
+
+// Sets up the opening position in lane, with policy first at seat 0
+void sim_start(SimBatch *batch, int lane, int first) {
+    for (int i = 0; i < CASES; i++) {
+        batch->pits[i][lane] = MAX_GRAINS / CASES;
+    }
+    batch->score[0][lane] = 0;
+    batch->score[1][lane] = 0;
+    batch->joueur[lane] = 0;
+    batch->first[lane] = (uint8_t)first;
+    batch->plies[lane] = 0;
+    batch->state[lane] = SIM_LIVE;
+    batch->legal[lane] = 0x3F;
+}
+
+void sim_lane_board(const SimBatch *batch, int lane, Board *board) {
+    for (int i = 0; i < CASES; i++) {
+        board->pits[i] = batch->pits[i][lane];
+    }
+    board->score[0] = batch->score[0][lane];
+    board->score[1] = batch->score[1][lane];
+}
+
+// Adds to pit p of every lane its share of the seeds being sown. The row
+// never overlaps the scratch arrays; restrict tells the compiler so, which
+// lets it vectorize the loop without a runtime check.
+static void sow_row(uint8_t *restrict row, int p, const uint8_t *restrict origins,
+                    const uint8_t *restrict laps, const uint8_t *restrict rests) {
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        // Distance from the origin, 0 only on the origin itself (never for NO_ORIGIN)
+        uint8_t d = (uint8_t)(p + CASES - origins[lane]);
+        d = d >= CASES ? (uint8_t)(d - CASES) : d;
+        uint8_t add = (uint8_t)(laps[lane] + (d <= rests[lane]));
+        row[lane] = d == 0 ? 0 : (uint8_t)(row[lane] + add);
+    }
+}
+
+// Sows batch->move in every live lane. Whole laps and the remaining run are
+// added pit row by pit row; only fetching the seeds and finding where the
+// last one lands look at one lane at a time.
+static void sow_all(SimBatch *batch) {
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        if (batch->state[lane] != SIM_LIVE) {
+            continue;
+        }
+        int origin = batch->joueur[lane] * CAMP_SIZE + batch->move[lane];
+        int seeds = batch->pits[origin][lane];
+        batch->origin[lane] = (uint8_t)origin;
+        batch->laps[lane] = (uint8_t)(seeds / (CASES - 1));
+        batch->rest[lane] = (uint8_t)(seeds % (CASES - 1));
+    }
+
+    for (int p = 0; p < CASES; p++) {
+        sow_row(batch->pits[p], p, batch->origin, batch->laps, batch->rest);
+    }
+}
+
+// Captures after sowing, as rules_play() does, then hands the move over
+static void capture_all(SimBatch *batch) {
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        if (batch->state[lane] != SIM_LIVE) {
+            continue;
+        }
+        int origin = batch->origin[lane];
+        int rest = batch->rest[lane];
+        int last = rest > 0 ? (origin + rest) % CASES : (origin + CASES - 1) % CASES;
+        int joueur = batch->joueur[lane];
+        int first = (1 - joueur) * CAMP_SIZE;
+        int end = last;
+        int captured = 0;
+
+        while (end >= first && end < first + CAMP_SIZE &&
+               (batch->pits[end][lane] == 2 || batch->pits[end][lane] == 3)) {
+            captured += batch->pits[end][lane];
+            end--;
+        }
+        int camp = 0;
+        for (int i = first; i < first + CAMP_SIZE; i++) {
+            camp += batch->pits[i][lane];
+        }
+        if (captured > 0 && captured < camp) { // Not a grand slam
+            for (int i = last; i > end; i--) {
+                batch->pits[i][lane] = 0;
+            }
+            batch->score[joueur][lane] += (uint8_t)captured;
+        }
+
+        batch->joueur[lane] = (uint8_t)(1 - joueur);
+        batch->plies[lane]++;
+        batch->origin[lane] = NO_ORIGIN;
+        batch->laps[lane] = 0;
+        batch->rest[lane] = 0;
+    }
+}
+
+// Plays one ply in every live lane: the first random_plies plies at random,
+// then each mover's policy. Returns the number of lanes still live; the ones
+// that just finished are left SIM_OVER for sim_record().
+int sim_step(SimBatch *batch, const SimPolicy policies[2], int random_plies) {
+    static const SimPolicy opening = {"random", choose_random, 0};
+    uint16_t lanes[3][SIM_LANES];
+    int counts[3] = {0, 0, 0};
+
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        if (batch->state[lane] != SIM_LIVE) {
+            continue;
+        }
+        int group = batch->plies[lane] < random_plies ? 2 : batch->first[lane] ^ batch->joueur[lane];
+        lanes[group][counts[group]++] = (uint16_t)lane;
+    }
+    for (int group = 0; group < 3; group++) {
+        if (counts[group] > 0) {
+            const SimPolicy *policy = group < 2 ? &policies[group] : &opening;
+            policy->choose(policy, batch, lanes[group], counts[group]);
+        }
+    }
+
+    sow_all(batch);
+    capture_all(batch);
+    legal_masks(batch);
+
+    int live = 0;
+    for (int lane = 0; lane < SIM_LANES; lane++) {
+        if (batch->state[lane] == SIM_LIVE) {
+            check_end(batch, lane);
+            live += batch->state[lane] == SIM_LIVE;
+        }
+    }
+    return live;
+}
+
+void sim_record(const SimBatch *batch, int lane, SimRecord *record) {
+    record->score[0] = batch->score[0][lane];
+    record->score[1] = batch->score[1][lane];
+    record->info = (uint16_t)(batch->plies[lane] | batch->end[lane] << 10 | batch->first[lane] << 12);
+}
+
+typedef struct {
+    const SimConfig *config;
+    pthread_t thread;
+    uint64_t seed;
+    SimTotals totals;
+} SimWorker;
+
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t next_game;
+
+static void write_records(const SimConfig *config, const SimRecord *records, int count) {
+    if (!config->out || count == 0) {
+        return;
+    }
+    pthread_mutex_lock(&out_lock);
+    if (fwrite(records, sizeof(SimRecord), count, config->out) != (size_t)count) {
+        perror("fwrite()");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_unlock(&out_lock);
+}
+
+// Takes the next game number, or returns 0 once every game has been handed out.
+// Even games put policy 0 at seat 0, odd ones policy 1.
+static int claim_game(const SimConfig *config, int *first) {
+    uint64_t game = __atomic_fetch_add(&next_game, 1, __ATOMIC_RELAXED);
+    if (game >= config->games) {
+        return 0;
+    }
+    *first = (int)(game & 1);
+    return 1;
+}
+
+static void count_game(SimTotals *totals, const SimRecord *record) {
+    int first = record->info >> 12 & 1;
+    totals->games++;
+    totals->plies += record->info & 0x3FF;
+    totals->ends[record->info >> 10 & 3]++;
+    if (record->score[0] == record->score[1]) {
+        totals->draws++;
+    } else {
+        int seat = record->score[0] > record->score[1] ? 0 : 1;
+        totals->wins[first ^ seat]++;
+    }
+}
+
+static void *worker_main(void *arg) {
+    SimWorker *worker = arg;
+    const SimConfig *config = worker->config;
+    SimBatch *batch = malloc(sizeof(SimBatch));
+    SimRecord *records = malloc(SIM_RECORD_BATCH * sizeof(SimRecord));
+    if (!batch || !records) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    int pending = 0;
+    int first;
+
+    sim_batch_init(batch, worker->seed);
+    for (int lane = 0; lane < SIM_LANES && claim_game(config, &first); lane++) {
+        sim_start(batch, lane, first);
+    }
+
+    int live = 1;
+    while (live > 0) {
+        live = sim_step(batch, config->policies, config->random_plies);
+        for (int lane = 0; lane < SIM_LANES; lane++) {
+            if (batch->state[lane] != SIM_OVER) {
+                continue;
+            }
+            sim_record(batch, lane, &records[pending]);
+            count_game(&worker->totals, &records[pending]);
+            if (++pending == SIM_RECORD_BATCH) {
+                write_records(config, records, pending);
+                pending = 0;
+            }
+            batch->state[lane] = SIM_IDLE;
+            if (claim_game(config, &first)) {
+                sim_start(batch, lane, first);
+                live++;
+            }
+        }
+    }
+    write_records(config, records, pending);
+
+    free(records);
+    free(batch);
+    return NULL;
+}
+
+// Plays config->games games between the two policies on config->threads
+// threads, each with its own batch, streaming the records to config->out
+void sim_run(const SimConfig *config, SimTotals *totals) {
+    int threads = config->threads < 1 ? 1 : config->threads;
+    if (threads > SIM_MAX_THREADS) {
+        threads = SIM_MAX_THREADS;
+    }
+    SimWorker *workers = calloc(threads, sizeof(SimWorker));
+    if (!workers) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    SimHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIM_MAGIC, sizeof(header.magic));
+    for (int i = 0; i < 2; i++) {
+        memcpy(header.policies[i], config->policies[i].name, sizeof(header.policies[i]));
+    }
+    if (config->out && fwrite(&header, sizeof(header), 1, config->out) != 1) {
+        perror("fwrite()");
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t seed = config->seed;
+    next_game = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i].config = config;
+        workers[i].seed = splitmix64(&seed);
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            perror("pthread_create()");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(totals, 0, sizeof(*totals));
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        SimTotals *part = &workers[i].totals;
+        totals->games += part->games;
+        totals->wins[0] += part->wins[0];
+        totals->wins[1] += part->wins[1];
+        totals->draws += part->draws;
+        totals->plies += part->plies;
+        for (int e = 0; e < 3; e++) {
+            totals->ends[e] += part->ends[e];
+        }
+    }
+    free(workers);
+
+    if (config->out) {
+        header.games = totals->games;
+        if (fseek(config->out, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, config->out) != 1) {
+            perror("Failed to finish the simulation file");
+        }
+    }
+}
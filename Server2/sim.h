@@ -0,0 +1,108 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "awale.h"
+
+// Bulk self-play for rating calibration and engine tuning. A batch holds
+// SIM_LANES independent games laid out as a struct of arrays: one row per pit
+// with a byte per lane. Each ply, every lane takes a move from its policy,
+// then sowing runs pit by pit over all the lanes at once, which the compiler
+// turns into vector code. Finished lanes start a new game straight away, so
+// the batch stays full until the last games.
+
+#define SIM_LANES       1024
+#define SIM_MAX_PLIES   400    // Games still going are stopped here, each side keeping its camp
+#define SIM_MAX_THREADS 256
+#define SIM_RECORD_BATCH 4096  // Records a worker gathers before writing them out
+#define SIM_MAGIC       "AWSIM01"
+
+typedef enum {
+    SIM_END_CAPTURE = 0,   // One side took more than half the seeds
+    SIM_END_NO_MOVES = 1,  // The side to move could not play
+    SIM_END_PLY_LIMIT = 2  // SIM_MAX_PLIES reached, usually a cycle
+} SimEnd;
+
+typedef enum {
+    SIM_IDLE = 0, // No game in this lane
+    SIM_LIVE = 1, // Game in progress
+    SIM_OVER = 2  // Finished, its record not yet taken
+} SimLaneState;
+
+typedef struct {
+    uint8_t pits[CASES][SIM_LANES];
+    uint8_t score[2][SIM_LANES];
+    uint8_t joueur[SIM_LANES];  // Seat to move
+    uint8_t legal[SIM_LANES];   // Bit i set when pit i of the mover's camp may be played
+    uint8_t move[SIM_LANES];    // Pit (0-5) picked by the policy for this ply
+    uint8_t first[SIM_LANES];   // Policy sitting at seat 0
+    uint8_t state[SIM_LANES];
+    uint8_t end[SIM_LANES];     // SimEnd, once over
+    uint16_t plies[SIM_LANES];
+    uint64_t rng[SIM_LANES];
+    // Per-ply scratch for sowing
+    uint8_t origin[SIM_LANES];
+    uint8_t laps[SIM_LANES];
+    uint8_t rest[SIM_LANES];
+} SimBatch;
+
+typedef struct SimPolicy SimPolicy;
+
+// Sets batch->move for each of the count lanes listed, among their legal pits
+typedef void (*SimChoose)(const SimPolicy *policy, SimBatch *batch, const uint16_t *lanes, int count);
+
+struct SimPolicy {
+    char name[24];
+    SimChoose choose;
+    int depth; // Search depth, for the search policy
+};
+
+// One finished game in the output file
+typedef struct {
+    uint8_t score[2]; // Final seeds of seat 0 and seat 1
+    uint16_t info;    // Plies in bits 0-9, SimEnd in bits 10-11, policy at seat 0 in bit 12
+} SimRecord;
+
+// Output file: this header, then one SimRecord per game in no particular order.
+// games is filled in when the run completes; an interrupted file still holds
+// whole records.
+typedef struct {
+    char magic[8];
+    char policies[2][24];
+    uint64_t games;
+} SimHeader;
+
+typedef struct {
+    SimPolicy policies[2];
+    uint64_t games;
+    int threads;
+    int random_plies; // Opening plies played at random, so that deterministic policies vary
+    uint64_t seed;
+    FILE *out;        // NULL to only count
+} SimConfig;
+
+typedef struct {
+    uint64_t games;
+    uint64_t wins[2]; // By policy
+    uint64_t draws;
+    uint64_t plies;
+    uint64_t ends[3]; // By SimEnd
+} SimTotals;
+
+int sim_policy(const char *name, SimPolicy *policy);
+
+void sim_batch_init(SimBatch *batch, uint64_t seed);
+
+void sim_start(SimBatch *batch, int lane, int first);
+
+void sim_lane_board(const SimBatch *batch, int lane, Board *board);
+
+int sim_step(SimBatch *batch, const SimPolicy policies[2], int random_plies);
+
+void sim_record(const SimBatch *batch, int lane, SimRecord *record);
+
+void sim_run(const SimConfig *config, SimTotals *totals);
+
+#endif /* SIM_H */
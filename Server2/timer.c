@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "timer.h"
+
+uint64_t timer_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void timer_add(TimerHeap *timers, uint64_t deadline, uint64_t token) {
+    if (timers->count == timers->capacity) {
+        int new_capacity = timers->capacity ? timers->capacity * 2 : 64;
+        Timer *grown = realloc(timers->heap, new_capacity * sizeof(Timer));
+        if (!grown) {
+            perror("realloc failed");
+            exit(EXIT_FAILURE);
+        }
+        timers->heap = grown;
+        timers->capacity = new_capacity;
+    }
+
+    // Sift up from the new leaf
+    int i = timers->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (timers->heap[parent].deadline <= deadline) {
+            break;
+        }
+        timers->heap[i] = timers->heap[parent];
+        i = parent;
+    }
+    timers->heap[i].deadline = deadline;
+    timers->heap[i].token = token;
+}
+
+// Milliseconds until the earliest deadline, as epoll_wait() expects: -1 if there is none
+int timer_next_timeout(const TimerHeap *timers, uint64_t now) {
+    if (timers->count == 0) {
+        return -1;
+    }
+    uint64_t deadline = timers->heap[0].deadline;
+    return deadline <= now ? 0 : (int)(deadline - now);
+}
+
+// Removes the earliest timer if it is due. Returns 1 and its token, or 0 if none is due.
+int timer_pop_expired(TimerHeap *timers, uint64_t now, uint64_t *token) {
+    if (timers->count == 0 || timers->heap[0].deadline > now) {
+        return 0;
+    }
+    *token = timers->heap[0].token;
+
+    // Sift the last leaf down from the root
+    Timer last = timers->heap[--timers->count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= timers->count) {
+            break;
+        }
+        if (child + 1 < timers->count && timers->heap[child + 1].deadline < timers->heap[child].deadline) {
+            child++;
+        }
+        if (last.deadline <= timers->heap[child].deadline) {
+            break;
+        }
+        timers->heap[i] = timers->heap[child];
+        i = child;
+    }
+    timers->heap[i] = last;
+    return 1;
+}
+
+void timer_clear(TimerHeap *timers) {
+    free(timers->heap);
+    memset(timers, 0, sizeof(*timers));
+}
@@ -0,0 +1,31 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Deadlines owned by one reactor thread, kept in a binary min-heap. Timers are
+// never cancelled: the token identifies what the deadline was for, and the
+// owner checks on expiry whether it still applies.
+
+typedef struct {
+    uint64_t deadline; // Milliseconds on the monotonic clock
+    uint64_t token;
+} Timer;
+
+typedef struct {
+    Timer *heap;
+    int count;
+    int capacity;
+} TimerHeap;
+
+uint64_t timer_now(void);
+
+void timer_add(TimerHeap *timers, uint64_t deadline, uint64_t token);
+
+int timer_next_timeout(const TimerHeap *timers, uint64_t now);
+
+int timer_pop_expired(TimerHeap *timers, uint64_t now, uint64_t *token);
+
+void timer_clear(TimerHeap *timers);
+
+#endif /* TIMER_H */
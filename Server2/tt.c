@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tt.h"
+
+_Static_assert(sizeof(TTBucket) == TT_CACHE_LINE, "A bucket must fill one cache line");
+
+// data layout: score (16 bits, signed), depth (8), bound (8), move + 1 (8)
+#define DATA_SCORE(d) ((int)(int16_t)((d) & 0xFFFF))
+#define DATA_DEPTH(d) ((int)(((d) >> 16) & 0xFF))
+#define DATA_BOUND(d) ((int)(((d) >> 24) & 0xFF))
+#define DATA_MOVE(d)  ((int)(((d) >> 32) & 0xFF) - 1)
+
+static uint64_t pack(int depth, int score, int bound, int move) {
+    return (uint64_t)(uint16_t)score | (uint64_t)depth << 16 | (uint64_t)bound << 24 |
+           (uint64_t)(move + 1) << 32;
+}
+
+// Other threads may be writing the slot: each word is read once, atomically
+static void load_slot(const TTSlot *slot, uint64_t *key, uint64_t *data) {
+    *data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+    *key = __atomic_load_n(&slot->check, __ATOMIC_RELAXED) ^ *data;
+}
+
+// The table gets the largest power of two of buckets that fits in bytes
+void tt_init(TransTable *tt, size_t bytes) {
+    size_t count = 1;
+    while (count * 2 * sizeof(TTBucket) <= bytes) {
+        count *= 2;
+    }
+
+    tt->buckets = aligned_alloc(TT_CACHE_LINE, count * sizeof(TTBucket));
+    if (!tt->buckets) {
+        perror("aligned_alloc failed");
+        exit(EXIT_FAILURE);
+    }
+    tt->mask = count - 1;
+    tt_clear(tt);
+}
+
+void tt_free(TransTable *tt) {
+    free(tt->buckets);
+    tt->buckets = NULL;
+}
+
+// Not while a search is using the table
+void tt_clear(TransTable *tt) {
+    memset(tt->buckets, 0, (tt->mask + 1) * sizeof(TTBucket));
+    memset(&tt->stats, 0, sizeof(tt->stats));
+}
+
+// The low bits of the key pick the bucket, the whole key identifies the entry.
+// Returns 1 and fills entry when the position is in the table.
+int tt_probe(TransTable *tt, uint64_t key, TTEntry *entry) {
+    TTBucket *bucket = &tt->buckets[key & tt->mask];
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        uint64_t slot_key, data;
+        load_slot(&bucket->slots[i], &slot_key, &data);
+        if (slot_key == key && DATA_DEPTH(data) > 0) {
+            entry->score = DATA_SCORE(data);
+            entry->depth = DATA_DEPTH(data);
+            entry->bound = DATA_BOUND(data);
+            entry->move = DATA_MOVE(data);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// depth must be at least 1: leaves are not worth an entry. An entry for the same
+// position is kept when it is deeper, unless the new score is exact.
+// Returns 1 when another position was evicted.
+int tt_store(TransTable *tt, uint64_t key, int depth, int score, int bound, int move) {
+    TTBucket *bucket = &tt->buckets[key & tt->mask];
+    TTSlot *victim = &bucket->slots[0];
+    int victim_depth = 256; // Deeper than any entry
+    int evicts = 0;
+
+    for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+        uint64_t slot_key, data;
+        load_slot(&bucket->slots[i], &slot_key, &data);
+        if (slot_key == key && DATA_DEPTH(data) > depth && bound != TT_EXACT) {
+            // A shallow bound (say from a Lazy SMP helper) would only lose information
+            return 0;
+        }
+        if (DATA_DEPTH(data) == 0 || slot_key == key) {
+            victim = &bucket->slots[i];
+            evicts = 0;
+            break;
+        }
+        if (DATA_DEPTH(data) < victim_depth) {
+            victim = &bucket->slots[i];
+            victim_depth = DATA_DEPTH(data);
+            evicts = 1;
+        }
+    }
+
+    uint64_t data = pack(depth > 255 ? 255 : depth, score, bound, move);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+    return evicts;
+}
+
+void tt_add_stats(TransTable *tt, const TTStats *stats) {
+    __atomic_fetch_add(&tt->stats.probes, stats->probes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tt->stats.hits, stats->hits, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tt->stats.stores, stats->stores, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&tt->stats.overwrites, stats->overwrites, __ATOMIC_RELAXED);
+}
+
+size_t tt_bytes(const TransTable *tt) {
+    return (tt->mask + 1) * sizeof(TTBucket);
+}
+
+double tt_hit_rate(const TransTable *tt) {
+    return tt->stats.probes ? (double)tt->stats.hits / tt->stats.probes : 0.0;
+}
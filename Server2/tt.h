@@ -0,0 +1,74 @@
+#ifndef TT_H
+#define TT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-size transposition table for the search. Entries are grouped by four
+// in 64-byte buckets aligned on cache lines, so a probe touches one line.
+// A position goes in the bucket its Zobrist key selects: it replaces its own
+// older entry, else the shallowest of the four (depth-preferred).
+//
+// Several search threads may share one table without locks: a slot holds the
+// packed entry and the key XORed with it, written as two independent words.
+// A slot torn by concurrent writers no longer decodes to its key and simply
+// reads as a miss.
+
+#define TT_BUCKET_ENTRIES 4
+#define TT_CACHE_LINE     64
+
+typedef enum {
+    TT_EXACT, // score is the value of the position
+    TT_LOWER, // The search failed high: the value is at least score
+    TT_UPPER  // The search failed low: the value is at most score
+} TTBound;
+
+typedef struct {
+    int score;
+    int depth; // Plies searched below the position, at least 1
+    int bound;
+    int move;  // Best pit (0-5), -1 if none
+} TTEntry;
+
+typedef struct {
+    uint64_t check; // key ^ data
+    uint64_t data;  // Packed TTEntry
+} TTSlot;
+
+typedef struct {
+    TTSlot slots[TT_BUCKET_ENTRIES];
+} TTBucket;
+
+// Counters to size the table against the memory budget: a low hit rate with
+// many overwrites means the table is too small for the searches it serves.
+// Searches count on their own and add their totals once they finish.
+typedef struct {
+    uint64_t probes;
+    uint64_t hits;       // Probes that found their position
+    uint64_t stores;
+    uint64_t overwrites; // Stores that evicted another position
+} TTStats;
+
+typedef struct {
+    TTBucket *buckets;
+    uint64_t mask; // Bucket count - 1
+    TTStats stats;
+} TransTable;
+
+void tt_init(TransTable *tt, size_t bytes);
+
+void tt_free(TransTable *tt);
+
+void tt_clear(TransTable *tt);
+
+int tt_probe(TransTable *tt, uint64_t key, TTEntry *entry);
+
+int tt_store(TransTable *tt, uint64_t key, int depth, int score, int bound, int move);
+
+void tt_add_stats(TransTable *tt, const TTStats *stats);
+
+size_t tt_bytes(const TransTable *tt);
+
+double tt_hit_rate(const TransTable *tt);
+
+#endif /* TT_H */
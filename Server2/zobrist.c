@@ -0,0 +1,45 @@
+#include <pthread.h>
+
+#include "zobrist.h"
+
+uint64_t zobrist_pits[CASES][MAX_GRAINS + 1];
+uint64_t zobrist_scores[2][MAX_GRAINS + 1];
+uint64_t zobrist_side;
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void fill_tables(void) {
+    uint64_t state = 0x417A6C65; // "Awale"
+    for (int i = 0; i < CASES; i++) {
+        for (int n = 0; n <= MAX_GRAINS; n++) {
+            zobrist_pits[i][n] = splitmix64(&state);
+        }
+    }
+    for (int j = 0; j < 2; j++) {
+        for (int n = 0; n <= MAX_GRAINS; n++) {
+            zobrist_scores[j][n] = splitmix64(&state);
+        }
+    }
+    zobrist_side = splitmix64(&state);
+}
+
+// The key of a position from scratch. Every search starts here, so the
+// tables are filled before any incremental update reads them.
+uint64_t zobrist_key(const Board *board, int joueur) {
+    pthread_once(&tables_once, fill_tables);
+
+    uint64_t key = joueur == 1 ? zobrist_side : 0;
+    for (int i = 0; i < CASES; i++) {
+        key ^= zobrist_pits[i][board->pits[i]];
+    }
+    key ^= zobrist_scores[0][board->score[0]];
+    key ^= zobrist_scores[1][board->score[1]];
+    return key;
+}
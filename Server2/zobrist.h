@@ -0,0 +1,20 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+#include "awale.h"
+
+// Zobrist keys of positions: one random number per (pit, seed count), per
+// (player, score) and for the side to move, XORed together. A move changes
+// only a few of them, so sowing and capturing update the key as they go
+// (board_sow_keyed(), rules_play_keyed()) instead of rehashing the board.
+// The numbers come from a fixed seed: keys are the same in every run.
+
+extern uint64_t zobrist_pits[CASES][MAX_GRAINS + 1];
+extern uint64_t zobrist_scores[2][MAX_GRAINS + 1];
+extern uint64_t zobrist_side; // Present when player 1 is to move
+
+uint64_t zobrist_key(const Board *board, int joueur);
+
+#endif /* ZOBRIST_H */
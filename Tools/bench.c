@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../Server2/awale.h"
+#include "../Server2/engine.h"
+#include "../Server2/rules.h"
+#include "../Server2/timer.h"
+#include "../Server2/tt.h"
+
+// Engine benchmarks. Every measurement is one JSON object per line on stdout,
+// so runs can be compared by scripts:
+//   awale_bench all                 the fixed suite below, as run by make bench
+//   awale_bench moves               jouer_coup() and rules_play() throughput
+//   awale_bench perft               leaf counts to a fixed depth from every position
+//   awale_bench search              fixed-depth search of every position
+//   awale_bench smp [max threads]   time-to-depth and nodes/sec from 1 to N threads
+// Node counts do not depend on the machine: a change in them is a change in
+// the rules or the search, not in speed.
+
+#define MOVES_COUNT   10000000 // Moves played by the throughput runs
+#define MOVES_GAME    200     // Moves before a throughput game starts over
+#define PERFT_DEPTH   10
+#define SEARCH_DEPTH  14
+#define SEARCH_TT_BYTES (16 << 20)
+#define SMP_DEPTH     16
+#define SMP_TT_BYTES  (64 << 20)
+
+typedef struct {
+    Board board;
+    int joueur;
+} BenchPosition;
+
+// The opening, then positions from engine games, from the middle game to the end
+static const BenchPosition positions[] = {
+    {{{4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4}, {0, 0}}, 0},
+    {{{0, 3, 8, 8, 6, 0, 0, 0, 9, 1, 7, 6}, {0, 0}}, 0},
+    {{{9, 0, 4, 1, 9, 0, 0, 13, 0, 8, 3, 1}, {0, 0}}, 0},
+    {{{0, 15, 0, 0, 0, 2, 0, 0, 7, 4, 12, 4}, {2, 2}}, 0},
+    {{{1, 14, 0, 1, 4, 12, 0, 0, 2, 2, 0, 1}, {8, 3}}, 0},
+    {{{1, 1, 0, 2, 5, 13, 0, 0, 11, 1, 2, 0}, {2, 10}}, 0},
+};
+
+#define POSITION_COUNT ((int)(sizeof(positions) / sizeof(positions[0])))
+
+// The compiler and its settings, so that results are only compared like for like
+static void bench_build(void) {
+#ifdef __OPTIMIZE__
+    int optimized = 1;
+#else
+    int optimized = 0;
+#endif
+    printf("{\"bench\":\"build\",\"compiler\":\"%s\",\"optimized\":%d,\"cores\":%ld}\n",
+           __VERSION__, optimized, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+// xorshift64: the same move sequence on every machine
+static uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void print_rate(const char *bench, const char *kernel, uint64_t moves, double ms) {
+    printf("{\"bench\":\"%s\",\"kernel\":\"%s\",\"moves\":%llu,\"ms\":%.0f,\"moves_per_sec\":%.0f}\n",
+           bench, kernel, (unsigned long long)moves, ms, ms > 0 ? moves * 1000.0 / ms : 0.0);
+    fflush(stdout);
+}
+
+// Random games with the server's Plateau API, then with the engine's kernel.
+// Pits are drawn among the non-empty ones, as the server checks moves first.
+static void bench_moves(void) {
+    uint64_t state = 0x2545F4914F6CDD1DULL;
+    uint64_t played = 0;
+    uint64_t start = timer_now();
+    Plateau plateau;
+    init_plateau(&plateau);
+    for (int joueur = 0; played < MOVES_COUNT; joueur = 1 - joueur) {
+        int pit = (int)(next_random(&state) % (CASES / 2));
+        int k = 0;
+        while (k < CASES / 2 && plateau.cases[joueur * (CASES / 2) + pit] == 0) {
+            pit = (pit + 1) % (CASES / 2);
+            k++;
+        }
+        if (k == CASES / 2 || played % MOVES_GAME == MOVES_GAME - 1 ||
+            jouer_coup(&plateau, joueur, pit)) {
+            init_plateau(&plateau);
+            joueur = 1;
+        }
+        played++;
+    }
+    print_rate("moves", "jouer_coup", played, (double)(timer_now() - start));
+
+    state = 0x2545F4914F6CDD1DULL;
+    played = 0;
+    start = timer_now();
+    Board board;
+    board_init(&board);
+    for (int joueur = 0; played < MOVES_COUNT; joueur = 1 - joueur) {
+        int mask = rules_legal_mask(&board, joueur);
+        int pit = (int)(next_random(&state) % (CASES / 2));
+        while (mask && !(mask & (1 << pit))) {
+            pit = (pit + 1) % (CASES / 2);
+        }
+        if (!mask || played % MOVES_GAME == MOVES_GAME - 1) {
+            board_init(&board);
+            joueur = 1;
+        } else {
+            rules_play(&board, joueur, pit);
+        }
+        played++;
+    }
+    print_rate("moves", "rules_play", played, (double)(timer_now() - start));
+}
+
+// Positions reached by every sequence of depth legal moves; finished games
+// stop early and count for nothing
+static uint64_t perft(const Board *board, int joueur, int depth) {
+    if (depth == 0) {
+        return 1;
+    }
+    Board position = *board;
+    if (rules_game_over(&position, joueur)) {
+        return 0;
+    }
+
+    uint64_t count = 0;
+    int mask = rules_legal_mask(&position, joueur);
+    for (int pit = 0; pit < CASES / 2; pit++) {
+        if (mask & (1 << pit)) {
+            Board child = position;
+            rules_play(&child, joueur, pit);
+            count += perft(&child, 1 - joueur, depth - 1);
+        }
+    }
+    return count;
+}
+
+static void bench_perft(void) {
+    for (int i = 0; i < POSITION_COUNT; i++) {
+        uint64_t start = timer_now();
+        uint64_t nodes = perft(&positions[i].board, positions[i].joueur, PERFT_DEPTH);
+        double ms = (double)(timer_now() - start);
+        printf("{\"bench\":\"perft\",\"position\":%d,\"depth\":%d,\"nodes\":%llu,\"ms\":%.0f,\"nps\":%.0f}\n",
+               i, PERFT_DEPTH, (unsigned long long)nodes, ms, ms > 0 ? nodes * 1000.0 / ms : 0.0);
+        fflush(stdout);
+    }
+}
+
+// One thread, an empty table for each position
+static void bench_search(void) {
+    TransTable tt;
+    tt_init(&tt, SEARCH_TT_BYTES);
+    for (int i = 0; i < POSITION_COUNT; i++) {
+        SearchResult result;
+        tt_clear(&tt);
+        uint64_t start = timer_now();
+        engine_search(&positions[i].board, positions[i].joueur, 1 << 30, SEARCH_DEPTH, &tt, &result);
+        double ms = (double)(timer_now() - start);
+        printf("{\"bench\":\"search\",\"position\":%d,\"depth\":%d,\"pit\":%d,\"score\":%d,\"nodes\":%llu,"
+               "\"ms\":%.0f,\"nps\":%.0f,\"tt_hit_rate\":%.3f}\n",
+               i, result.depth, result.pit, result.score, (unsigned long long)result.nodes, ms,
+               ms > 0 ? result.nodes * 1000.0 / ms : 0.0, tt_hit_rate(&tt));
+        fflush(stdout);
+    }
+    tt_free(&tt);
+}
+
+// Searches every position to SMP_DEPTH with 1, 2, 4... threads up to
+// max_threads, from an empty table each time
+static void bench_smp(int max_threads) {
+    TransTable tt;
+    double base_ms = 0;
+    tt_init(&tt, SMP_TT_BYTES);
+
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        uint64_t nodes = 0;
+        uint64_t start = timer_now();
+        for (int i = 0; i < POSITION_COUNT; i++) {
+            SearchResult result;
+            tt_clear(&tt);
+            engine_search_parallel(&positions[i].board, positions[i].joueur, 1 << 30, SMP_DEPTH, threads, &tt, &result);
+            nodes += result.nodes;
+        }
+        double ms = (double)(timer_now() - start);
+        if (threads == 1) {
+            base_ms = ms;
+        }
+        printf("{\"bench\":\"smp\",\"threads\":%d,\"depth\":%d,\"positions\":%d,\"ms\":%.0f,\"nodes\":%llu,"
+               "\"nps\":%.0f,\"speedup\":%.2f}\n",
+               threads, SMP_DEPTH, POSITION_COUNT, ms, (unsigned long long)nodes,
+               ms > 0 ? nodes * 1000.0 / ms : 0.0, ms > 0 ? base_ms / ms : 0.0);
+        fflush(stdout);
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    tt_free(&tt);
+}
+
+int main(int argc, char **argv) {
+    const char *suite = argc > 1 ? argv[1] : "all";
+    int all = strcmp(suite, "all") == 0;
+
+    if (!all && strcmp(suite, "moves") != 0 && strcmp(suite, "perft") != 0 && strcmp(suite, "search") != 0 &&
+        strcmp(suite, "smp") != 0) {
+        fprintf(stderr, "Usage: %s [all | moves | perft | search | smp [max threads]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_build();
+    if (all || strcmp(suite, "moves") == 0) {
+        bench_moves();
+    }
+    if (all || strcmp(suite, "perft") == 0) {
+        bench_perft();
+    }
+    if (all || strcmp(suite, "search") == 0) {
+        bench_search();
+    }
+    if (strcmp(suite, "smp") == 0) {
+        int max_threads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        bench_smp(max_threads > 0 ? max_threads : 1);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "../Server2/awale.h"
+#include "../Server2/book.h"
+#include "../Server2/rules.h"
+#include "../Server2/zobrist.h"
+#include "../Server2/bot.h"
+
+// Builds the opening book (see Server2/book.h) from the game records:
+//   awale_book [--full]
+//
+// A record lists the board after every move; the moves are recovered by
+// finding, between two boards in a row, the pit that turns one into the other.
+// The games already mined are listed in BOOK_SEEN_FILE, so a plain run only
+// reads the games finished since and merges them into the existing book;
+// --full starts over from every record. Games against the bot are skipped: the
+// book would only learn its own lines back.
+
+#define GAMES_DIR       "Database/Games"
+#define BOOK_SEEN_FILE  "Database/book.seen"
+#define BOOK_MAX_PLY    20   // Moves of each game that go into the book
+#define MAX_BOARDS      1024
+#define NAME_SIZE       32
+#define LINE_SIZE       1024
+
+typedef struct {
+    BookEntry *entries;
+    size_t count;
+    size_t capacity;
+} EntryList;
+
+typedef struct {
+    char **names;
+    size_t count;
+    size_t capacity;
+} NameList;
+
+static void *grow(void *array, size_t *capacity, size_t size) {
+    *capacity = *capacity ? *capacity * 2 : 256;
+    array = realloc(array, *capacity * size);
+    if (!array) {
+        perror("realloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return array;
+}
+
+static void add_entry(EntryList *list, uint64_t key, int move, int outcome) {
+    if (list->count == list->capacity) {
+        list->entries = grow(list->entries, &list->capacity, sizeof(BookEntry));
+    }
+    BookEntry *entry = &list->entries[list->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->key = key;
+    entry->move = (uint8_t)move;
+    entry->games = 1;
+    entry->wins = outcome > 0;
+    entry->draws = outcome == 0;
+}
+
+static void add_name(NameList *list, const char *name) {
+    if (list->count == list->capacity) {
+        list->names = grow(list->names, &list->capacity, sizeof(char *));
+    }
+    list->names[list->count] = strdup(name);
+    if (!list->names[list->count]) {
+        perror("strdup failed");
+        exit(EXIT_FAILURE);
+    }
+    list->count++;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const BookEntry *x = a;
+    const BookEntry *y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return (int)x->move - (int)y->move;
+}
+
+// Reads a row of 6 pit counts; board rows hold nothing but digits and spaces
+static int parse_row(const char *line, int *row) {
+    for (const char *c = line; *c && *c != '\n'; c++) {
+        if (*c != ' ' && (*c < '0' || *c > '9')) {
+            return 0;
+        }
+    }
+    return sscanf(line, "%d %d %d %d %d %d", &row[0], &row[1], &row[2], &row[3], &row[4], &row[5]) == 6;
+}
+
+// Who won, from the result line: 0 or 1 for a seat, -1 for a draw, -2 unknown
+static int parse_result(const char *line, const char players[2][NAME_SIZE]) {
+    char name[NAME_SIZE];
+    if (strstr(line, "Draw")) {
+        return -1;
+    }
+    if (sscanf(line, "Game Result: Player %31s wins", name) == 1) {
+        return strcmp(name, players[0]) == 0 ? 0 : strcmp(name, players[1]) == 0 ? 1 : -2;
+    }
+    if (sscanf(line, "Game Result: Player %31s disconnected", name) == 1) {
+        return strcmp(name, players[0]) == 0 ? 1 : strcmp(name, players[1]) == 0 ? 0 : -2;
+    }
+    return -2;
+}
+
+// Adds the opening moves of one finished game to list. Returns the number of
+// moves recovered, or -1 if the game is still being played.
+static int mine_game(const char *path, EntryList *list) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        perror(path);
+        return 0;
+    }
+
+    static Board boards[MAX_BOARDS];
+    char players[2][NAME_SIZE] = {"", ""};
+    char line[LINE_SIZE];
+    int board_count = 0;
+    int rows = 0;
+    int row[6];
+    int winner = -2;
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        if (line_number == 2 || line_number == 3) {
+            sscanf(line, "%31s", players[line_number - 2]);
+        } else if (strncmp(line, "Game Result:", 12) == 0) {
+            winner = parse_result(line, players);
+        } else if (board_count < MAX_BOARDS && parse_row(line, row)) {
+            // The top row is the second camp right to left, then the first camp
+            for (int i = 0; i < 6; i++) {
+                if (rows == 0) {
+                    boards[board_count].pits[11 - i] = (uint8_t)row[i];
+                } else {
+                    boards[board_count].pits[i] = (uint8_t)row[i];
+                }
+            }
+            rows++;
+        } else if (rows == 2 && board_count < MAX_BOARDS) {
+            int score0, score1;
+            if (sscanf(line, "Score Joueur 1: %d | Score Joueur 2: %d", &score0, &score1) == 2) {
+                boards[board_count].score[0] = (uint8_t)score0;
+                boards[board_count].score[1] = (uint8_t)score1;
+                board_count++;
+                rows = 0;
+            }
+        }
+    }
+    fclose(file);
+    if (winner == -2) {
+        return -1;
+    }
+    if (strcmp(players[0], BOT_NAME) == 0 || strcmp(players[1], BOT_NAME) == 0) {
+        return 0;
+    }
+
+    int moves = 0;
+    for (int i = 1; i < board_count && moves < BOOK_MAX_PLY; i++) {
+        int joueur = (i - 1) % 2; // The first seat moves first and turns alternate
+        int played = -1;
+        for (int pit = 0; pit < CASES / 2 && played < 0; pit++) {
+            Board next = boards[i - 1];
+            if (!(rules_legal_mask(&next, joueur) & (1 << pit))) {
+                continue;
+            }
+            rules_play(&next, joueur, pit);
+            if (memcmp(&next, &boards[i], sizeof(Board)) == 0) {
+                played = pit;
+            }
+        }
+        if (played < 0) {
+            break; // Not a legal move: an old record or a damaged one
+        }
+        int outcome = winner == -1 ? 0 : winner == joueur ? 1 : -1;
+        add_entry(list, zobrist_key(&boards[i - 1], joueur), played, outcome);
+        moves++;
+    }
+    return moves;
+}
+
+// Adds the entries of the current book to list
+static void load_book(const char *path, EntryList *list) {
+    BookHeader header;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return;
+    }
+    if (fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, BOOK_MAGIC, sizeof(header.magic)) == 0) {
+        for (uint64_t i = 0; i < header.count; i++) {
+            if (list->count == list->capacity) {
+                list->entries = grow(list->entries, &list->capacity, sizeof(BookEntry));
+            }
+            if (fread(&list->entries[list->count], sizeof(BookEntry), 1, file) != 1) {
+                break;
+            }
+            list->count++;
+        }
+    }
+    fclose(file);
+}
+
+static void load_seen(NameList *seen) {
+    char line[LINE_SIZE];
+    FILE *file = fopen(BOOK_SEEN_FILE, "r");
+    if (!file) {
+        return;
+    }
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\n")] = '\0';
+        add_name(seen, line);
+    }
+    fclose(file);
+    qsort(seen->names, seen->count, sizeof(char *), compare_names);
+}
+
+// Sorts the entries and merges those of the same position and move
+static void merge_entries(EntryList *list) {
+    size_t out = 0;
+    qsort(list->entries, list->count, sizeof(BookEntry), compare_entries);
+    for (size_t i = 0; i < list->count; i++) {
+        if (out > 0 && compare_entries(&list->entries[out - 1], &list->entries[i]) == 0) {
+            list->entries[out - 1].games += list->entries[i].games;
+            list->entries[out - 1].wins += list->entries[i].wins;
+            list->entries[out - 1].draws += list->entries[i].draws;
+        } else {
+            list->entries[out++] = list->entries[i];
+        }
+    }
+    list->count = out;
+}
+
+// The new book replaces the old one at once: a server starting meanwhile maps
+// either of them, never half of one
+static int write_book(const char *path, const EntryList *list) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *file = fopen(tmp, "wb");
+    if (!file) {
+        perror("Failed to create the opening book");
+        return -1;
+    }
+
+    BookHeader header = {BOOK_MAGIC, list->count};
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(list->entries, sizeof(BookEntry), list->count, file) != list->count) {
+        perror("Failed to write the opening book");
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    if (rename(tmp, path) < 0) {
+        perror("rename(opening book)");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int full = argc > 1 && strcmp(argv[1], "--full") == 0;
+    EntryList list = {0};
+    NameList seen = {0};
+    NameList mined = {0};
+    int moves = 0;
+
+    if (!full) {
+        load_seen(&seen);
+        load_book(BOOK_FILE, &list);
+    }
+
+    DIR *dir = opendir(GAMES_DIR);
+    if (!dir) {
+        perror("opendir(" GAMES_DIR ")");
+        return EXIT_FAILURE;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        char *name = entry->d_name;
+        if (len < 4 || strcmp(entry->d_name + len - 4, ".txt") != 0 ||
+            bsearch(&name, seen.names, seen.count, sizeof(char *), compare_names)) {
+            continue;
+        }
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", GAMES_DIR, entry->d_name);
+        int found = mine_game(path, &list);
+        if (found >= 0) {
+            moves += found;
+            add_name(&mined, entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    merge_entries(&list);
+    if (write_book(BOOK_FILE, &list) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(BOOK_SEEN_FILE, full ? "w" : "a");
+    if (!file) {
+        perror("Failed to update " BOOK_SEEN_FILE);
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < mined.count; i++) {
+        fprintf(file, "%s\n", mined.names[i]);
+    }
+    fclose(file);
+
+    printf("%s: %zu games read, %d moves added, %zu entries\n", BOOK_FILE, mined.count, moves, list.count);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Server2/awale.h"
+#include "../Server2/egdb.h"
+#include "../Server2/rules.h"
+#include "../Server2/timer.h"
+
+// Builds the endgame database (see Server2/egdb.h), one level of seeds on the
+// board at a time, from 0 up:
+//   awale_egdb_gen [max seeds] [output file]
+//
+// A move that captures leads to a smaller level, already solved. A move that
+// does not stays on the same level, where play can go round in circles, so
+// each level is solved by retrograde iteration: every position keeps a lower
+// and an upper bound of its value, both tightened from its successors until
+// nothing moves. Positions where they still differ can only be decided by
+// playing forever: they get the value of ending the game there, or the
+// nearest bound. Every other value is exact.
+
+#define DEFAULT_MAX_SEEDS 12
+
+// Successors of one position within its level
+typedef struct {
+    uint64_t level_size;
+    int8_t *best_known; // Best value over the moves that leave the level
+    int8_t *lower;
+    int8_t *upper;
+    uint32_t *first;    // Successors of position i: same[first[i]] to same[first[i + 1] - 1]
+    uint32_t *same;
+    uint64_t same_count;
+    uint64_t same_capacity;
+} Level;
+
+typedef void (*PositionFn)(void *ctx, uint64_t rank, const uint8_t *pits);
+
+static void *checked_malloc(size_t size) {
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        perror("malloc failed");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+// Calls fn on every distribution of seeds over the pits, in rank order
+static void enumerate(uint8_t *pits, int pit, int left, uint64_t *rank, PositionFn fn, void *ctx) {
+    if (pit == CASES - 1) {
+        pits[pit] = (uint8_t)left;
+        fn(ctx, (*rank)++, pits);
+        return;
+    }
+    for (int n = 0; n <= left; n++) {
+        pits[pit] = (uint8_t)n;
+        enumerate(pits, pit + 1, left - n, rank, fn, ctx);
+    }
+}
+
+typedef struct {
+    Level *level;
+    int seeds;
+    const int8_t *table; // Values of the levels already solved
+} LinkContext;
+
+// Sorts the moves of one position into captures, whose value is known, and
+// quiet moves, whose successors stay on the level
+static void link_position(void *arg, uint64_t rank, const uint8_t *pits) {
+    LinkContext *ctx = arg;
+    Level *level = ctx->level;
+    Board board;
+    memcpy(board.pits, pits, CASES);
+    board.score[0] = board.score[1] = 0;
+
+    int mask = rules_legal_mask(&board, 0);
+    int best = -128;
+    level->first[rank] = (uint32_t)level->same_count;
+
+    if (mask == 0) {
+        // No move: each player keeps their own camp
+        int own = 0;
+        for (int i = 0; i < CASES; i++) {
+            own += i < CASES / 2 ? pits[i] : -pits[i];
+        }
+        level->best_known[rank] = (int8_t)own;
+        level->lower[rank] = level->upper[rank] = (int8_t)own;
+        return;
+    }
+
+    for (int pit = 0; pit < CASES / 2; pit++) {
+        if (!(mask & (1 << pit))) {
+            continue;
+        }
+        Board child = board;
+        int captured = rules_play(&child, 0, pit);
+        uint8_t next[CASES];
+        egdb_canonical(&child, 1, next);
+        if (captured > 0) {
+            int left = ctx->seeds - captured;
+            int value = captured - ctx->table[egdb_level_offset(left) + egdb_rank(next, left)];
+            if (value > best) {
+                best = value;
+            }
+        } else {
+            if (level->same_count == level->same_capacity) {
+                level->same_capacity = level->same_capacity ? level->same_capacity * 2 : 1024;
+                level->same = realloc(level->same, level->same_capacity * sizeof(uint32_t));
+                if (!level->same) {
+                    perror("realloc failed");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            level->same[level->same_count++] = (uint32_t)egdb_rank(next, ctx->seeds);
+        }
+    }
+    level->best_known[rank] = (int8_t)best;
+    level->lower[rank] = (int8_t)-ctx->seeds;
+    level->upper[rank] = (int8_t)ctx->seeds;
+}
+
+// One pass of bound tightening over the level. Returns the number of bounds
+// that moved; they only ever close in, so the passes end.
+static uint64_t tighten(Level *level) {
+    uint64_t changes = 0;
+    for (uint64_t i = 0; i < level->level_size; i++) {
+        if (level->lower[i] == level->upper[i]) {
+            continue;
+        }
+        int lower = level->best_known[i];
+        int upper = level->best_known[i];
+        for (uint32_t k = level->first[i]; k < level->first[i + 1]; k++) {
+            uint32_t next = level->same[k];
+            if (-level->upper[next] > lower) {
+                lower = -level->upper[next];
+            }
+            if (-level->lower[next] > upper) {
+                upper = -level->lower[next];
+            }
+        }
+        if (lower != level->lower[i] || upper != level->upper[i]) {
+            level->lower[i] = (int8_t)lower;
+            level->upper[i] = (int8_t)upper;
+            changes++;
+        }
+    }
+    return changes;
+}
+
+typedef struct {
+    Level *level;
+    int8_t *out;
+    uint64_t unresolved;
+} SettleContext;
+
+// Positions left open are decided as if the game stopped there
+static void settle_position(void *arg, uint64_t rank, const uint8_t *pits) {
+    SettleContext *ctx = arg;
+    Level *level = ctx->level;
+    int value = level->lower[rank];
+
+    if (level->lower[rank] != level->upper[rank]) {
+        int own = 0;
+        for (int i = 0; i < CASES; i++) {
+            own += i < CASES / 2 ? pits[i] : -pits[i];
+        }
+        value = own < level->lower[rank] ? level->lower[rank] : own > level->upper[rank] ? level->upper[rank] : own;
+        ctx->unresolved++;
+    }
+    ctx->out[rank] = (int8_t)value;
+}
+
+static void solve_level(int seeds, int8_t *table) {
+    uint64_t start = timer_now();
+    Level level = {0};
+    uint8_t pits[CASES];
+    uint64_t rank = 0;
+
+    level.level_size = egdb_level_size(seeds);
+    level.best_known = checked_malloc(level.level_size);
+    level.lower = checked_malloc(level.level_size);
+    level.upper = checked_malloc(level.level_size);
+    level.first = checked_malloc((level.level_size + 1) * sizeof(uint32_t));
+
+    LinkContext link = {&level, seeds, table};
+    enumerate(pits, 0, seeds, &rank, link_position, &link);
+    level.first[level.level_size] = (uint32_t)level.same_count;
+
+    int passes = 0;
+    while (tighten(&level) > 0) {
+        passes++;
+    }
+
+    SettleContext settle = {&level, table + egdb_level_offset(seeds), 0};
+    rank = 0;
+    enumerate(pits, 0, seeds, &rank, settle_position, &settle);
+
+    printf("%2d seeds: %10llu positions, %3d passes, %8llu decided by endless play, %llu ms\n", seeds,
+           (unsigned long long)level.level_size, passes, (unsigned long long)settle.unresolved,
+           (unsigned long long)(timer_now() - start));
+    fflush(stdout);
+
+    free(level.best_known);
+    free(level.lower);
+    free(level.upper);
+    free(level.first);
+    free(level.same);
+}
+
+int main(int argc, char **argv) {
+    int max_seeds = argc > 1 ? atoi(argv[1]) : DEFAULT_MAX_SEEDS;
+    const char *path = argc > 2 ? argv[2] : EGDB_FILE;
+    if (max_seeds < 0 || max_seeds > EGDB_MAX_SEEDS) {
+        fprintf(stderr, "Usage: %s [max seeds, 0-%d] [output file]\n", argv[0], EGDB_MAX_SEEDS);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t total = egdb_level_offset(max_seeds + 1);
+    int8_t *table = checked_malloc(total);
+    for (int seeds = 0; seeds <= max_seeds; seeds++) {
+        solve_level(seeds, table);
+    }
+
+    EgdbHeader header = {EGDB_MAGIC, (uint32_t)max_seeds, 0};
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror("Failed to create the endgame database");
+        return EXIT_FAILURE;
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(table, 1, total, file) != total) {
+        perror("Failed to write the endgame database");
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+    free(table);
+
+    printf("%s: %llu positions, up to %d seeds\n", path, (unsigned long long)total, max_seeds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../Server2/sim.h"
+#include "../Server2/timer.h"
+
+// Bulk self-play between two policies (see Server2/sim.h):
+//   awale_selfplay <policy> <policy> [games] [output file] [threads]
+// Policies are random, greedy and search<depth> (search4 is a 4-ply search).
+// Each policy plays half the games at seat 0. The first plies are random so
+// that games between deterministic policies differ. Records go to the output
+// file, 4 bytes per game, and the totals to stdout as one JSON object.
+
+#define DEFAULT_GAMES   100000
+#define DEFAULT_FILE    "Database/selfplay.bin"
+#define RANDOM_PLIES    4
+#define SEED            0x5E1F9A7ULL
+
+int main(int argc, char **argv) {
+    SimConfig config;
+    memset(&config, 0, sizeof(config));
+    if (argc < 3 || sim_policy(argv[1], &config.policies[0]) != 0 ||
+        sim_policy(argv[2], &config.policies[1]) != 0) {
+        fprintf(stderr, "Usage: %s <random|greedy|search<depth>> <random|greedy|search<depth>> "
+                        "[games] [output file] [threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    config.games = argc > 3 ? strtoull(argv[3], NULL, 10) : DEFAULT_GAMES;
+    const char *path = argc > 4 ? argv[4] : DEFAULT_FILE;
+    config.threads = argc > 5 ? atoi(argv[5]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    config.random_plies = RANDOM_PLIES;
+    config.seed = SEED;
+
+    config.out = fopen(path, "wb");
+    if (!config.out) {
+        perror("Failed to create the self-play file");
+        return EXIT_FAILURE;
+    }
+
+    SimTotals totals;
+    uint64_t start = timer_now();
+    sim_run(&config, &totals);
+    double ms = (double)(timer_now() - start);
+    if (fclose(config.out) != 0) {
+        perror("Failed to write the self-play file");
+        return EXIT_FAILURE;
+    }
+
+    printf("{\"file\":\"%s\",\"policies\":[\"%s\",\"%s\"],\"threads\":%d,\"games\":%llu,\"ms\":%.0f,"
+           "\"games_per_sec\":%.0f,\"wins\":[%llu,%llu],\"draws\":%llu,\"avg_plies\":%.1f,"
+           "\"ends\":{\"capture\":%llu,\"no_moves\":%llu,\"ply_limit\":%llu}}\n",
+           path, config.policies[0].name, config.policies[1].name, config.threads,
+           (unsigned long long)totals.games, ms, ms > 0 ? totals.games * 1000.0 / ms : 0.0,
+           (unsigned long long)totals.wins[0], (unsigned long long)totals.wins[1],
+           (unsigned long long)totals.draws, totals.games ? (double)totals.plies / totals.games : 0.0,
+           (unsigned long long)totals.ends[SIM_END_CAPTURE], (unsigned long long)totals.ends[SIM_END_NO_MOVES],
+           (unsigned long long)totals.ends[SIM_END_PLY_LIMIT]);
+    return EXIT_SUCCESS;
+}